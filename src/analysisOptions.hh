@@ -0,0 +1,84 @@
+// optional run settings for jetFindAnalysis
+// Nick Elsey
+
+// everything after the positional arguments is
+// read as key=value pairs, for instance
+//   ./bin/jetFindAnalysis xmldir 3 out/test.root sis_threads=4 sis_npass=1
+// unknown keys are reported at startup so a typo
+// does not silently run the default configuration
+
+#ifndef ANALYSISOPTIONS_HH
+#define ANALYSISOPTIONS_HH
+
+#include <map>
+#include <set>
+#include <string>
+#include <sstream>
+#include <iostream>
+
+class AnalysisOptions {
+public:
+
+  // parse argv[first] ... argv[argc-1]
+  // returns false if an argument is not of the form key=value
+  bool parse( int argc, const char** argv, int first ) {
+    for ( int i = first; i < argc; ++i ) {
+      std::string arg = argv[i];
+      std::size_t eq = arg.find( '=' );
+      if ( eq == std::string::npos || eq == 0 ) {
+        std::cerr<<"Error: option "<<arg<<" is not of the form key=value."<<std::endl;
+        return false;
+      }
+      options_[ arg.substr( 0, eq ) ] = arg.substr( eq + 1 );
+    }
+    return true;
+  }
+
+  bool has( const std::string& key ) const {
+    used_.insert( key );
+    return options_.count( key );
+  }
+
+  // returns the value for key, or def if the key was not given
+  // or could not be converted
+  template < typename T > T get( const std::string& key, const T& def ) const {
+    used_.insert( key );
+    std::map<std::string, std::string>::const_iterator it = options_.find( key );
+    if ( it == options_.end() )
+      return def;
+    std::istringstream stm( it->second );
+    T value;
+    if ( !( stm >> value ) ) {
+      std::cerr<<"Error: could not read option "<<key<<"="<<it->second<<", using default"<<std::endl;
+      return def;
+    }
+    return value;
+  }
+
+  std::string get( const std::string& key, const char* def ) const {
+    used_.insert( key );
+    std::map<std::string, std::string>::const_iterator it = options_.find( key );
+    if ( it == options_.end() )
+      return def;
+    return it->second;
+  }
+
+  // warn about any option that was given but never asked for
+  void reportUnused() const {
+    for ( std::map<std::string, std::string>::const_iterator it = options_.begin(); it != options_.end(); ++it )
+      if ( !used_.count( it->first ) )
+        std::cerr<<"Warning: option "<<it->first<<" is not used by this analysis"<<std::endl;
+  }
+
+  // print the options in effect
+  void print( std::ostream& os ) const {
+    for ( std::map<std::string, std::string>::const_iterator it = options_.begin(); it != options_.end(); ++it )
+      os<<"option: "<<it->first<<" = "<<it->second<<std::endl;
+  }
+
+private:
+  std::map<std::string, std::string> options_;
+  mutable std::set<std::string> used_;
+};
+
+#endif
@@ -0,0 +1,272 @@
+// reference vs fast clustering equivalence check
+// Nick Elsey
+
+// the production clusterings take their ghosts and cell ordered
+// particles from EventInput, and SISCone runs all radii at once.
+// before any such shortcut is trusted it has to give the same jets
+// as the plain path it replaced,
+//   fastjet::ClusterSequenceArea( allFinal, def, area_def )
+// with equiv_check set, a fraction of the events ( picked at a
+// fixed stride ) is clustered both ways for every jetfinder and
+// radius, and the jets above 1 GeV are compared one by one in pt
+// order:
+// - pt ( relative ), eta and phi within equiv_tol
+// - the number of real ( non ghost ) constituents, exactly
+// - the area within equiv_areatol
+// the reference ghosts are made from the ghost random state saved
+// before EventInput::prepare, so both paths see the same ghosts
+// and agree to rounding. after the check the random state is set
+// back to where prepare left it, so the production output does
+// not depend on whether the check ran.
+//
+// every mismatch is printed with the event number, jetfinder and
+// radius ( up to maxReports of them ), and write() prints per
+// configuration the jets compared and mismatched together with the
+// reference and production clustering time and their ratio, the
+// speedup. those numbers are stored as equivcheck ( configurations
+// x quantities ), booked only at the end so it is neither cross
+// section scaled nor averaged over MPI ranks
+
+#ifndef CLUSTEREQUIVALENCE_HH
+#define CLUSTEREQUIVALENCE_HH
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/JetDefinition.hh"
+#include "fastjet/AreaDefinition.hh"
+#include "fastjet/ClusterSequenceArea.hh"
+#include "fastjet/Selector.hh"
+#include "fastjet/SISConePlugin.hh"
+
+#include "TH2.h"
+
+#include "sisConeRunner.hh"
+
+#ifdef JETFIND_MPI
+#include <mpi.h>
+#endif
+
+class ClusterEquivalence {
+public:
+
+  ClusterEquivalence( double fraction, double tolerance, double areaTolerance,
+                      const std::vector<std::string>& jetfinders, const std::vector<double>& radii,
+                      const std::vector<std::string>& radiusLabels, const SISConeSettings& sisSettings ) :
+  fraction_( fraction ), tolerance_( tolerance ), areaTolerance_( areaTolerance ), jetfinders_( jetfinders ),
+  radiusLabels_( radiusLabels ), sums_( jetfinders.size() * radii.size() * nSums, 0.0 ),
+  sampled_( 0 ), checking_( false ), reported_( 0 ), prepTime_( 0 ) {
+    if ( !enabled() )
+      return;
+    if ( fraction_ > 1 ) {
+      std::cerr<<"Warning: equiv_check has to be in ( 0, 1 ], using 1"<<std::endl;
+      fraction_ = 1;
+    }
+    for ( unsigned i = 0; i < radii.size(); ++i ) {
+      sisPlugins_.push_back( std::unique_ptr<fastjet::SISConePlugin>(
+        new fastjet::SISConePlugin( radii[i], sisSettings.overlap_threshold, sisSettings.n_pass_max,
+                                    sisSettings.protojet_ptmin, false, fastjet::SISConePlugin::SM_pttilde,
+                                    sisSettings.split_merge_stopping_scale ) ) );
+      sisDefs_.push_back( fastjet::JetDefinition( sisPlugins_.back().get() ) );
+    }
+  }
+
+  bool enabled() const { return fraction_ > 0; }
+
+  // decide whether this event is checked, and save the ghost random
+  // state, call right before EventInput::prepare
+  bool beginEvent( const fastjet::GhostedAreaSpec& spec ) {
+    checking_ = false;
+    if ( !enabled() )
+      return false;
+    sampled_++;
+    checking_ = std::floor( sampled_ * fraction_ ) > std::floor( ( sampled_ - 1 ) * fraction_ );
+    if ( checking_ )
+      spec.get_random_status( before_ );
+    return checking_;
+  }
+
+  // call right after EventInput::prepare, time is its duration in ms
+  void prepared( const fastjet::GhostedAreaSpec& spec, double time ) {
+    if ( !checking_ )
+      return;
+    spec.get_random_status( after_ );
+    prepTime_ += time;
+  }
+
+  bool checking() const { return checking_; }
+
+  // the SISCone definition of the reference path at radius index r
+  const fastjet::JetDefinition& sisDefinition( unsigned r ) const { return sisDefs_[r]; }
+
+  // cluster particles with the reference path and compare with the
+  // production jets of jetfinder j at radius index r, which took
+  // fastTime ms
+  void compare( unsigned long event, unsigned j, unsigned r, const std::vector<fastjet::PseudoJet>& particles,
+                const fastjet::JetDefinition& def, const fastjet::AreaDefinition& areaDef,
+                const std::vector<fastjet::PseudoJet>& fastJets, double fastTime ) {
+    if ( !checking_ )
+      return;
+    typedef std::chrono::high_resolution_clock clock;
+    fastjet::GhostedAreaSpec spec = areaDef.ghost_spec();
+    spec.set_random_status( before_ );
+    std::chrono::time_point<clock> start = clock::now();
+    fastjet::ClusterSequenceArea reference( particles, def, areaDef );
+    double referenceTime = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+    std::vector<fastjet::PseudoJet> jets = fastjet::sorted_by_pt( fastjet::SelectorPtMin( 1.0 )( reference.inclusive_jets() ) );
+
+    double* sums = &sums_[( j * radiusLabels_.size() + r ) * nSums];
+    sums[events] += 1;
+    sums[referenceSum] += referenceTime;
+    sums[fastSum] += fastTime;
+
+    unsigned n = std::max( jets.size(), fastJets.size() );
+    unsigned bad = 0;
+    for ( unsigned k = 0; k < n; ++k ) {
+      std::string what;
+      if ( k >= jets.size() )
+        what = "only in the production jets";
+      else if ( k >= fastJets.size() )
+        what = "only in the reference jets";
+      else
+        what = difference( jets[k], fastJets[k] );
+      if ( what.empty() )
+        continue;
+      bad++;
+      if ( reported_ < maxReports ) {
+        const fastjet::PseudoJet& jet = k < jets.size() ? jets[k] : fastJets[k];
+        std::cout<<"equiv: event "<<event<<" "<<jetfinders_[j]<<" R = "<<radiusLabels_[r]<<" jet "<<k
+                 <<" ( pt "<<jet.pt()<<", eta "<<jet.eta()<<", phi "<<jet.phi()<<" ): "<<what<<std::endl;
+        if ( ++reported_ == maxReports )
+          std::cout<<"equiv: further mismatches are only counted"<<std::endl;
+      }
+    }
+    sums[jetSum] += n;
+    sums[mismatchSum] += bad;
+    sums[badEvents] += bad > 0;
+  }
+
+  // put the ghost random state back to where prepare left it
+  void endEvent( fastjet::GhostedAreaSpec& spec ) {
+    if ( checking_ )
+      spec.set_random_status( after_ );
+    checking_ = false;
+  }
+
+#ifdef JETFIND_MPI
+  // sum the totals onto rank 0
+  void reduce( int rank ) {
+    if ( !enabled() )
+      return;
+    sums_.push_back( prepTime_ );
+    std::vector<double> total( sums_.size() );
+    MPI_Reduce( &sums_[0], &total[0], sums_.size(), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+    if ( rank == 0 )
+      sums_ = total;
+    prepTime_ = sums_.back();
+    sums_.pop_back();
+  }
+#endif
+
+  // mismatches and speedup per configuration, as a table and histogram
+  void write() {
+    if ( !enabled() )
+      return;
+    const char* labels[nQuantities] = { "events", "jets", "mismatches", "mismatchevents", "referencetime", "fasttime", "speedup" };
+    unsigned nConfigs = sums_.size() / nSums;
+    TH2D* h = new TH2D( "equivcheck", "Reference vs Production Clustering", nConfigs, -0.5, nConfigs - 0.5,
+                        nQuantities, -0.5, nQuantities - 0.5 );
+    for ( int q = 0; q < nQuantities; ++q )
+      h->GetYaxis()->SetBinLabel( q+1, labels[q] );
+
+    std::cout<<"equivalence check: event fraction "<<fraction_<<", tolerance "<<tolerance_<<", area tolerance "<<areaTolerance_<<std::endl;
+    std::cout<<std::setw( 16 )<<"configuration"<<std::setw( 10 )<<"events"<<std::setw( 10 )<<"jets"
+             <<std::setw( 12 )<<"mismatches"<<std::setw( 14 )<<"reference ms"<<std::setw( 12 )<<"fast ms"<<std::setw( 10 )<<"speedup"<<std::endl;
+    double referenceTotal = 0, fastTotal = 0, mismatchTotal = 0;
+    for ( unsigned c = 0; c < nConfigs; ++c ) {
+      std::string name = jetfinders_[c / radiusLabels_.size()] + "_" + radiusLabels_[c % radiusLabels_.size()];
+      h->GetXaxis()->SetBinLabel( c+1, name.c_str() );
+      const double* sums = &sums_[c * nSums];
+      double speedup = sums[fastSum] > 0 ? sums[referenceSum] / sums[fastSum] : -1;
+      for ( int q = 0; q < nSums; ++q )
+        h->SetBinContent( c+1, q+1, sums[q] );
+      h->SetBinContent( c+1, speedupBin+1, speedup );
+      referenceTotal += sums[referenceSum];
+      fastTotal += sums[fastSum];
+      mismatchTotal += sums[mismatchSum];
+      if ( sums[events] > 0 )
+        std::cout<<std::setw( 16 )<<name<<std::setw( 10 )<<sums[events]<<std::setw( 10 )<<sums[jetSum]
+                 <<std::setw( 12 )<<sums[mismatchSum]<<std::setw( 14 )<<sums[referenceSum]<<std::setw( 12 )<<sums[fastSum]
+                 <<std::setw( 10 )<<speedup<<std::endl;
+    }
+    h->Write();
+    // the shared preparation is paid once per event for all configurations
+    if ( fastTotal + prepTime_ > 0 )
+      std::cout<<"equivalence check: "<<mismatchTotal<<" mismatched jets, speedup "<<referenceTotal / ( fastTotal + prepTime_ )
+               <<" including the shared preparation ( "<<prepTime_<<" ms )"<<std::endl;
+  }
+
+private:
+
+  enum Sum { events = 0, jetSum, mismatchSum, badEvents, referenceSum, fastSum, nSums };
+  enum Quantity { speedupBin = nSums, nQuantities };
+  static const unsigned maxReports = 50;
+
+  // what differs between the reference and production jet, empty if
+  // they agree within the tolerances
+  std::string difference( const fastjet::PseudoJet& reference, const fastjet::PseudoJet& fast ) const {
+    std::string what;
+    if ( std::fabs( fast.pt() - reference.pt() ) > tolerance_ * reference.pt() )
+      what += " pt " + number( fast.pt() );
+    if ( std::fabs( fast.eta() - reference.eta() ) > tolerance_ )
+      what += " eta " + number( fast.eta() );
+    double dphi = std::fabs( fast.phi() - reference.phi() );
+    if ( std::min( dphi, 2.0 * M_PI - dphi ) > tolerance_ )
+      what += " phi " + number( fast.phi() );
+    unsigned nReference = realConstituents( reference ), nFast = realConstituents( fast );
+    if ( nReference != nFast )
+      what += " constituents " + number( nReference ) + " / " + number( nFast );
+    if ( std::fabs( fast.area() - reference.area() ) > areaTolerance_ )
+      what += " area " + number( reference.area() ) + " / " + number( fast.area() );
+    return what.empty() ? what : "production differs in" + what;
+  }
+
+  static unsigned realConstituents( const fastjet::PseudoJet& jet ) {
+    std::vector<fastjet::PseudoJet> constituents = jet.constituents();
+    unsigned n = 0;
+    for ( unsigned i = 0; i < constituents.size(); ++i )
+      n += !constituents[i].is_pure_ghost();
+    return n;
+  }
+
+  static std::string number( double x ) {
+    std::ostringstream out;
+    out<<x;
+    return out.str();
+  }
+
+  double fraction_;
+  double tolerance_;
+  double areaTolerance_;
+  std::vector<std::string> jetfinders_;
+  std::vector<std::string> radiusLabels_;
+  std::vector<std::unique_ptr<fastjet::SISConePlugin> > sisPlugins_;
+  std::vector<fastjet::JetDefinition> sisDefs_;
+  std::vector<double> sums_;
+  unsigned long sampled_;
+  bool checking_;
+  unsigned reported_;
+  double prepTime_;
+  std::vector<int> before_;
+  std::vector<int> after_;
+};
+
+#endif
@@ -0,0 +1,133 @@
+// clustering cost against input multiplicity
+// Nick Elsey
+
+// the *clustertime histograms only record time against radius,
+// so here every clustering is also recorded against the number
+// of particles it actually processed, ghosts included:
+// - <jetfinder>timevsn : TProfile2D of the mean time ( ms )
+//   against radius and input size
+// - <jetfinder>timefitsums : the sums needed for a least squares
+//   fit of ln t = ln C + alpha ln N per radius. they are kept as
+//   a histogram so they survive hadd and the MPI reduction
+// at the end of the run fit() turns the sums into the empirical
+// scaling exponent alpha and constant C ( t in ms for N inputs )
+// for every jetfinder and radius, printed as a table and written
+// as the histograms scalingexponent and scalingconstant
+
+#ifndef CLUSTERSCALING_HH
+#define CLUSTERSCALING_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+#include "TH2.h"
+#include "TProfile2D.h"
+
+class ClusterScaling {
+public:
+
+  ClusterScaling( const std::vector<std::string>& jetfinders, const std::vector<std::string>& radiusLabels ) :
+  jetfinders_( jetfinders ), radiusLabels_( radiusLabels ) {
+    // log spaced input sizes from 10^2 to 10^6
+    const int nSizeBins = 80;
+    double sizeBins[nSizeBins+1];
+    for ( int i = 0; i <= nSizeBins; ++i )
+      sizeBins[i] = std::pow( 10.0, 2.0 + 4.0 * i / nSizeBins );
+
+    int nRadii = radiusLabels_.size();
+    for ( unsigned i = 0; i < jetfinders_.size(); ++i ) {
+      TProfile2D* profile = new TProfile2D( ( jetfinders_[i] + "timevsn" ).c_str(), ( "Clustering Time vs Input Size - " + jetfinders_[i] ).c_str(),
+                                            nRadii, -0.5, nRadii - 0.5, nSizeBins, sizeBins );
+      TH2D* sums = new TH2D( ( jetfinders_[i] + "timefitsums" ).c_str(), ( "Scaling Fit Sums - " + jetfinders_[i] ).c_str(),
+                             nRadii, -0.5, nRadii - 0.5, nSums, -0.5, nSums - 0.5 );
+      for ( int j = 0; j < nRadii; ++j ) {
+        profile->GetXaxis()->SetBinLabel( j+1, radiusLabels_[j].c_str() );
+        sums->GetXaxis()->SetBinLabel( j+1, radiusLabels_[j].c_str() );
+      }
+      profiles_.push_back( profile );
+      sums_.push_back( sums );
+    }
+  }
+
+  // record one clustering of n inputs that took time ms
+  void fill( unsigned jetfinder, unsigned radius, double n, double time ) {
+    profiles_[jetfinder]->Fill( radius, n, time );
+    if ( n <= 0 || time <= 0 )
+      return;
+    double x = std::log( n );
+    double y = std::log( time );
+    double values[nSums] = { 1, x, y, x * x, x * y, y * y };
+    for ( int k = 0; k < nSums; ++k )
+      sums_[jetfinder]->Fill( radius, k, values[k] );
+  }
+
+  // fit every jetfinder and radius, print the table and write the
+  // results into the current directory
+  void fit( std::ostream& os ) {
+    int nRadii = radiusLabels_.size();
+    int nJetfinders = jetfinders_.size();
+    TH2D* exponent = new TH2D( "scalingexponent", "Empirical Scaling Exponent of t = C N^{#alpha}",
+                               nJetfinders, -0.5, nJetfinders - 0.5, nRadii, -0.5, nRadii - 0.5 );
+    TH2D* constant = new TH2D( "scalingconstant", "Empirical Scaling Constant of t = C N^{#alpha} ( ms )",
+                               nJetfinders, -0.5, nJetfinders - 0.5, nRadii, -0.5, nRadii - 0.5 );
+
+    os<<"clustering time scaling, t [ms] = C * N^alpha"<<std::endl;
+    os<<std::setw( 10 )<<"jetfinder"<<std::setw( 8 )<<"R"<<std::setw( 10 )<<"points"
+      <<std::setw( 12 )<<"alpha"<<std::setw( 12 )<<"+-"<<std::setw( 14 )<<"C"<<std::endl;
+    for ( int i = 0; i < nJetfinders; ++i ) {
+      exponent->GetXaxis()->SetBinLabel( i+1, jetfinders_[i].c_str() );
+      constant->GetXaxis()->SetBinLabel( i+1, jetfinders_[i].c_str() );
+      for ( int j = 0; j < nRadii; ++j ) {
+        exponent->GetYaxis()->SetBinLabel( j+1, radiusLabels_[j].c_str() );
+        constant->GetYaxis()->SetBinLabel( j+1, radiusLabels_[j].c_str() );
+
+        double s[nSums];
+        for ( int k = 0; k < nSums; ++k )
+          s[k] = sums_[i]->GetBinContent( j+1, k+1 );
+        double n = s[0];
+        double sxx = s[3] - s[1] * s[1] / n;
+        double sxy = s[4] - s[1] * s[2] / n;
+        double syy = s[5] - s[2] * s[2] / n;
+        if ( n < 3 || sxx <= 0 ) {
+          os<<std::setw( 10 )<<jetfinders_[i]<<std::setw( 8 )<<radiusLabels_[j]<<std::setw( 10 )<<n
+            <<"   not enough spread in N to fit"<<std::endl;
+          continue;
+        }
+        double alpha = sxy / sxx;
+        double lnC = ( s[2] - alpha * s[1] ) / n;
+        double residual = std::max( syy - alpha * sxy, 0.0 ) / ( n - 2 );
+        double alphaError = std::sqrt( residual / sxx );
+
+        exponent->SetBinContent( i+1, j+1, alpha );
+        exponent->SetBinError( i+1, j+1, alphaError );
+        constant->SetBinContent( i+1, j+1, std::exp( lnC ) );
+        os<<std::setw( 10 )<<jetfinders_[i]<<std::setw( 8 )<<radiusLabels_[j]<<std::setw( 10 )<<n
+          <<std::setw( 12 )<<alpha<<std::setw( 12 )<<alphaError<<std::setw( 14 )<<std::exp( lnC )<<std::endl;
+      }
+    }
+    exponent->Write();
+    constant->Write();
+  }
+
+  void write() {
+    for ( unsigned i = 0; i < profiles_.size(); ++i ) {
+      profiles_[i]->Write();
+      sums_[i]->Write();
+    }
+  }
+
+private:
+
+  // n, sum x, sum y, sum x^2, sum xy, sum y^2 with x = ln N, y = ln t
+  static const int nSums = 6;
+
+  std::vector<std::string> jetfinders_;
+  std::vector<std::string> radiusLabels_;
+  std::vector<TProfile2D*> profiles_;
+  std::vector<TH2D*> sums_;
+};
+
+#endif
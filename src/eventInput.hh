@@ -0,0 +1,102 @@
+// shared per-event clustering input
+// Nick Elsey
+
+// every event is clustered 40 times ( 4 jetfinders x 10 radii )
+// from the same particles. with ClusterSequenceArea each of those
+// generates its own set of explicit ghosts - the bulk of the
+// inputs, about 30k for our acceptance - and reorders nothing,
+// so the setup is repeated 40 times. EventInput does it once:
+// - the ghosts are generated once per event with the analysis
+//   GhostedAreaSpec, and every clustering takes them through the
+//   ClusterSequenceActiveAreaExplicitGhosts constructor with
+//   external ghosts. the areas are the same as before, since
+//   that is the class ClusterSequenceArea builds internally
+// - the particles are stored in rapidity - phi cell order, so
+//   neighbouring particles are also neighbours in memory for
+//   the tiled clustering strategies. PseudoJet caches rapidity,
+//   phi and kt2 on construction, and the copies made by the
+//   clustering keep that cache, so nothing is recomputed
+// the tiling itself is internal to FastJet and is still built
+// by each clustering; it is not something we can hand in
+// the charged particles are prepared the same way and share the
+// ghosts, so charged jets cost one extra clustering per definition
+//
+// note: the ghosts are made here on the calling thread, so the
+// SISCone workers no longer touch the ghost random generator
+
+#ifndef EVENTINPUT_HH
+#define EVENTINPUT_HH
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/AreaDefinition.hh"
+#include "fastjet/ClusterSequenceActiveAreaExplicitGhosts.hh"
+
+class EventInput {
+public:
+
+  EventInput( const fastjet::GhostedAreaSpec& ghostSpec, double cellSize = 0.1 ) :
+  ghostSpec_( ghostSpec ), cellSize_( cellSize ), ghostArea_( 0 ), time_( 0 ) {
+    nPhiCells_ = std::ceil( 2.0 * M_PI / cellSize_ );
+  }
+
+  // sort the event into cells and make this event's ghosts
+  void prepare( const std::vector<fastjet::PseudoJet>& particles, const std::vector<fastjet::PseudoJet>& charged ) {
+    typedef std::chrono::high_resolution_clock clock;
+    std::chrono::time_point<clock> start = clock::now();
+
+    cellOrder( particles, particles_ );
+    cellOrder( charged, charged_ );
+
+    ghosts_.clear();
+    ghostSpec_.add_ghosts( ghosts_ );
+    ghostArea_ = ghostSpec_.actual_ghost_area();
+
+    time_ = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+  }
+
+  // cluster the prepared event, the caller owns the sequence
+  fastjet::ClusterSequenceActiveAreaExplicitGhosts* cluster( const fastjet::JetDefinition& def, bool charged = false ) const {
+    return new fastjet::ClusterSequenceActiveAreaExplicitGhosts( charged ? charged_ : particles_, def, ghosts_, ghostArea_ );
+  }
+
+  const std::vector<fastjet::PseudoJet>& particles() const { return particles_; }
+  const std::vector<fastjet::PseudoJet>& charged() const { return charged_; }
+  const std::vector<fastjet::PseudoJet>& ghosts() const { return ghosts_; }
+  double ghostArea() const { return ghostArea_; }
+  // time in ms spent preparing the last event
+  double time() const { return time_; }
+
+private:
+
+  void cellOrder( const std::vector<fastjet::PseudoJet>& in, std::vector<fastjet::PseudoJet>& out ) {
+    keys_.resize( in.size() );
+    for ( unsigned i = 0; i < in.size(); ++i ) {
+      long rapCell = std::floor( in[i].rap() / cellSize_ );
+      long phiCell = std::floor( in[i].phi() / cellSize_ );
+      keys_[i] = std::make_pair( rapCell * nPhiCells_ + phiCell, i );
+    }
+    std::sort( keys_.begin(), keys_.end() );
+    out.clear();
+    out.reserve( in.size() );
+    for ( unsigned i = 0; i < keys_.size(); ++i )
+      out.push_back( in[keys_[i].second] );
+  }
+
+  fastjet::GhostedAreaSpec ghostSpec_;
+  double cellSize_;
+  long nPhiCells_;
+
+  std::vector<std::pair<long, unsigned> > keys_;
+  std::vector<fastjet::PseudoJet> particles_;
+  std::vector<fastjet::PseudoJet> charged_;
+  std::vector<fastjet::PseudoJet> ghosts_;
+  double ghostArea_;
+  double time_;
+};
+
+#endif
@@ -0,0 +1,177 @@
+// pre-clustering event trigger
+// Nick Elsey
+
+// every event goes through all clusterings of the sweep, so an
+// event that can not contribute is the most expensive thing the
+// analysis does. the trigger runs on the particle buffer before
+// any clustering and rejects events that fail
+// - parton acceptance: both outgoing partons inside the track
+//   acceptance ( the sweep does not load the event otherwise )
+// - trig_leadpt: pt of the hardest particle
+// - trig_windowpt: the largest summed pt in a trig_window x
+//   trig_window rapidity - phi window. the windows are 2 x 2
+//   blocks of half-window cells, so they overlap by half a window
+// the particle pt, rapidity and phi are copied into flat arrays
+// first, the leading pt and the cell indices are then plain loops
+// over them. triggerxsec counts all, passed per criterion and
+// accepted events with the event weight, so the ratio of its bins
+// is the accept rate. the time saved is estimated from the mean
+// processing time of the accepted events
+
+#ifndef EVENTTRIGGER_HH
+#define EVENTTRIGGER_HH
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "TH1.h"
+
+struct TriggerSettings {
+  double leadPt;     // minimum leading particle pt, 0 = off
+  double windowPt;   // minimum summed pt in a window, 0 = off
+  double window;     // window size in rapidity and phi
+  double maxRap;     // particle acceptance
+  TriggerSettings() : leadPt( 0 ), windowPt( 0 ), window( 1.0 ), maxRap( 4.0 ) { }
+};
+
+class EventTrigger {
+public:
+
+  explicit EventTrigger( const TriggerSettings& settings ) :
+  settings_( settings ), nAccepted_( 0 ), nRejected_( 0 ), triggerTime_( 0 ), acceptedTime_( 0 ) {
+    nRapCells_ = std::max( (int) std::ceil( 2.0 * settings_.maxRap / ( 0.5 * settings_.window ) ), 2 );
+    nPhiCells_ = std::max( (int) std::floor( 2.0 * M_PI / ( 0.5 * settings_.window ) ), 2 );
+    cells_.resize( nRapCells_ * nPhiCells_ );
+
+    const char* labels[nBins] = { "all", "partons", "leadpt", "windowpt", "accepted" };
+    xsec_ = new TH1D( "triggerxsec", "Events Passing each Trigger Criterion", nBins, -0.5, nBins - 0.5 );
+    for ( int i = 0; i < nBins; ++i )
+      xsec_->GetXaxis()->SetBinLabel( i+1, labels[i] );
+    time_ = new TH1D( "triggertime", "Trigger Decision Time per Event", 500, 0, 0.5 );
+  }
+
+  // true if the event should be clustered
+  bool accept( const std::vector<fastjet::PseudoJet>& particles, const std::vector<fastjet::PseudoJet>& partons, double weight ) {
+    typedef std::chrono::high_resolution_clock clock;
+    std::chrono::time_point<clock> start = clock::now();
+    bool result = decide( particles, partons, weight );
+    double elapsed = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+    time_->Fill( elapsed );
+    triggerTime_ += elapsed;
+    if ( result ) {
+      xsec_->Fill( accepted, weight );
+      nAccepted_++;
+    }
+    else
+      nRejected_++;
+    return result;
+  }
+
+  // processing time of an accepted event in ms
+  void eventDone( double time ) { acceptedTime_ += time; }
+
+  // accept rate and estimated time saved
+  void report() const {
+    unsigned long total = nAccepted_ + nRejected_;
+    if ( total == 0 )
+      return;
+    double meanTime = nAccepted_ ? acceptedTime_ / nAccepted_ : 0;
+    std::cout<<"trigger: accepted "<<nAccepted_<<" of "<<total<<" events ( "<<100.0 * nAccepted_ / total<<" % ), saved about "
+             <<( nRejected_ * meanTime - triggerTime_ ) / 1000.0<<" s of processing for "<<triggerTime_ / 1000.0<<" s of trigger time"<<std::endl;
+  }
+
+  void write() {
+    xsec_->Write();
+    time_->Write();
+  }
+
+private:
+
+  enum Bin { all = 0, partonBin, leadPtBin, windowPtBin, accepted, nBins };
+
+  bool decide( const std::vector<fastjet::PseudoJet>& particles, const std::vector<fastjet::PseudoJet>& partons, double weight ) {
+    xsec_->Fill( all, weight );
+    if ( partons.size() < 2 )
+      return false;
+    xsec_->Fill( partonBin, weight );
+    if ( settings_.leadPt <= 0 && settings_.windowPt <= 0 ) {
+      xsec_->Fill( leadPtBin, weight );
+      xsec_->Fill( windowPtBin, weight );
+      return true;
+    }
+
+    unsigned n = particles.size();
+    pt_.resize( n );
+    rap_.resize( n );
+    phi_.resize( n );
+    for ( unsigned i = 0; i < n; ++i ) {
+      pt_[i] = particles[i].pt();
+      rap_[i] = particles[i].rap();
+      phi_[i] = particles[i].phi();
+    }
+
+    if ( settings_.leadPt > 0 ) {
+      double lead = 0;
+      for ( unsigned i = 0; i < n; ++i )
+        lead = std::max( lead, pt_[i] );
+      if ( lead < settings_.leadPt )
+        return false;
+    }
+    xsec_->Fill( leadPtBin, weight );
+
+    if ( settings_.windowPt > 0 && windowPt() < settings_.windowPt )
+      return false;
+    xsec_->Fill( windowPtBin, weight );
+    return true;
+  }
+
+  // largest summed pt over the 2 x 2 cell windows, phi wraps around
+  double windowPt() {
+    unsigned n = pt_.size();
+    index_.resize( n );
+    double rapScale = nRapCells_ / ( 2.0 * settings_.maxRap );
+    double phiScale = nPhiCells_ / ( 2.0 * M_PI );
+    for ( unsigned i = 0; i < n; ++i ) {
+      int rap = std::min( std::max( (int) ( ( rap_[i] + settings_.maxRap ) * rapScale ), 0 ), nRapCells_ - 1 );
+      int phi = std::min( (int) ( phi_[i] * phiScale ), nPhiCells_ - 1 );
+      index_[i] = rap * nPhiCells_ + phi;
+    }
+    std::fill( cells_.begin(), cells_.end(), 0.0 );
+    for ( unsigned i = 0; i < n; ++i )
+      cells_[index_[i]] += pt_[i];
+
+    double best = 0;
+    for ( int rap = 0; rap + 1 < nRapCells_; ++rap ) {
+      const double* row = &cells_[rap * nPhiCells_];
+      const double* next = row + nPhiCells_;
+      for ( int phi = 0; phi < nPhiCells_; ++phi ) {
+        int phi2 = phi + 1 < nPhiCells_ ? phi + 1 : 0;
+        best = std::max( best, row[phi] + row[phi2] + next[phi] + next[phi2] );
+      }
+    }
+    return best;
+  }
+
+  TriggerSettings settings_;
+  int nRapCells_;
+  int nPhiCells_;
+  std::vector<double> cells_;
+  std::vector<double> pt_;
+  std::vector<double> rap_;
+  std::vector<double> phi_;
+  std::vector<int> index_;
+
+  TH1D* xsec_;
+  TH1D* time_;
+  unsigned long nAccepted_;
+  unsigned long nRejected_;
+  double triggerTime_;
+  double acceptedTime_;
+};
+
+#endif
@@ -0,0 +1,276 @@
+// approximate leading jet finder
+// Nick Elsey
+
+// the lead jet histograms only need one jet per event, but the
+// sweep clusters every event inclusively, with area, for every
+// jetfinder and radius. with fastlead set, the leading jet of
+// every radius is instead found by a seeded cone in linear time:
+// - cone: the seed is the hardest particle
+// - grid: the seed is the pt weighted centre of the hardest
+//   rapidity - phi cell of size R
+// the cone of radius R around the seed is summed, and recentred
+// on the sum until it is stable ( at most maxIterations times ).
+// fastlead<observable> are filled for every event, with the same
+// binning as the anti-kt lead jet histograms.
+//
+// the rest of the event, from the multiplicities to the full
+// clustering, then only runs on a fraction fastlead_validate of
+// the events, picked at a fixed stride and filled with the event
+// weight / fraction so the normalization is unchanged ( main turns
+// on the sum of squared weights for it ). on those events the approximate jet is compared
+// with the anti-kt leading jet of the same radius:
+// - fastleadvalfound   : 1 if it is within R / 2 of it
+// - fastleadvalptratio : pt approximate / pt anti-kt
+// - fastleadvaldr      : their distance
+// and the efficiency and resolutions are printed at the end
+
+#ifndef FASTLEADJET_HH
+#define FASTLEADJET_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "TH1.h"
+#include "TH2.h"
+
+#include "histStorage.hh"
+
+class FastLeadJet {
+public:
+
+  enum Seed { none, cone, grid };
+
+  FastLeadJet( const std::string& mode, double fraction, const std::vector<double>& radii,
+               const std::vector<std::string>& radiusLabels, double maxRap ) :
+  seed_( none ), fraction_( fraction ), radii_( radii ), leads_( radii.size() ),
+  nConstituents_( radii.size(), 0 ), sampled_( 0 ), time_( 0 ), timeHist_( 0 ) {
+    if ( mode == "cone" )
+      seed_ = cone;
+    else if ( mode == "grid" )
+      seed_ = grid;
+    else if ( mode != "none" )
+      std::cerr<<"Warning: unknown fastlead mode "<<mode<<", using none"<<std::endl;
+    if ( seed_ == none )
+      return;
+    if ( fraction_ <= 0 || fraction_ > 1 ) {
+      std::cerr<<"Warning: fastlead_validate has to be in ( 0, 1 ], using 1"<<std::endl;
+      fraction_ = 1;
+    }
+
+    const char* names[nHists] = { "ptlead", "elead", "etalead", "npartlead", "deltaR", "deltaE",
+                                  "valfound", "valptratio", "valdr" };
+    const char* titles[nHists] = { "Lead Jet Pt", "Lead Jet Energy", "Lead Jet Eta", "Number of Particles per Leading Jet",
+                                   "#Delta R Leading", "#Delta E", "Found within R/2 of the Anti-Kt Lead Jet",
+                                   "Pt / Anti-Kt Lead Jet Pt", "#Delta R to the Anti-Kt Lead Jet" };
+    const int bins[nHists] = { 100, 100, 100, 100, 100, 100, 2, 100, 100 };
+    const double lower[nHists] = { 0, 0, -maxRap, -0.5, 0, -100, -0.5, 0, 0 };
+    const double upper[nHists] = { 1000, 1000, maxRap, 599.5, 2.0, 100, 1.5, 2.0, 1.0 };
+    int nRadii = radiusLabels.size();
+    for ( int k = 0; k < nHists; ++k ) {
+      TH2* h = newRadiusHist( ( std::string( "fastlead" ) + names[k] ).c_str(), ( std::string( titles[k] ) + " - Fast Lead" ).c_str(),
+                              nRadii, -0.5, nRadii - 0.5, bins[k], lower[k], upper[k] );
+      for ( int j = 0; j < nRadii; ++j )
+        h->GetXaxis()->SetBinLabel( j+1, radiusLabels[j].c_str() );
+      hists_.push_back( h );
+    }
+    timeHist_ = new TH1D( "fastleadtime", "Approximate Lead Jet Time per Event", 500, 0, 5 );
+  }
+
+  bool enabled() const { return seed_ != none; }
+
+  // whether this event also goes through the full clustering
+  bool sample() {
+    if ( !enabled() )
+      return true;
+    sampled_++;
+    return std::floor( sampled_ * fraction_ ) > std::floor( ( sampled_ - 1 ) * fraction_ );
+  }
+
+  // the weight of the fully clustered events
+  double sampleWeight() const { return enabled() ? 1.0 / fraction_ : 1.0; }
+
+  // find the leading jet at every radius and fill its histograms
+  void find( const std::vector<fastjet::PseudoJet>& particles, const std::vector<fastjet::PseudoJet>& partons, double weight ) {
+    if ( !enabled() )
+      return;
+    typedef std::chrono::high_resolution_clock clock;
+    std::chrono::time_point<clock> start = clock::now();
+
+    unsigned n = particles.size();
+    px_.resize( n );
+    py_.resize( n );
+    pz_.resize( n );
+    e_.resize( n );
+    pt_.resize( n );
+    rap_.resize( n );
+    phi_.resize( n );
+    unsigned hardest = 0;
+    for ( unsigned i = 0; i < n; ++i ) {
+      px_[i] = particles[i].px();
+      py_[i] = particles[i].py();
+      pz_[i] = particles[i].pz();
+      e_[i] = particles[i].E();
+      pt_[i] = particles[i].pt();
+      rap_[i] = particles[i].rap();
+      phi_[i] = particles[i].phi();
+      if ( pt_[i] > pt_[hardest] )
+        hardest = i;
+    }
+
+    for ( unsigned r = 0; r < radii_.size(); ++r ) {
+      leads_[r] = fastjet::PseudoJet();
+      nConstituents_[r] = 0;
+      if ( n == 0 )
+        continue;
+      double rap = rap_[hardest];
+      double phi = phi_[hardest];
+      if ( seed_ == grid )
+        gridSeed( radii_[r], rap, phi );
+      for ( int iteration = 0; iteration < maxIterations; ++iteration ) {
+        coneSum( radii_[r], rap, phi, leads_[r], nConstituents_[r] );
+        if ( leads_[r].pt2() <= 0 )
+          break;
+        double dy = leads_[r].rap() - rap;
+        double dphi = std::fabs( leads_[r].phi() - phi );
+        dphi = std::min( dphi, 2.0 * M_PI - dphi );
+        rap = leads_[r].rap();
+        phi = leads_[r].phi();
+        if ( dy * dy + dphi * dphi < stable * stable )
+          break;
+      }
+
+      const fastjet::PseudoJet& jet = leads_[r];
+      if ( jet.pt2() <= 0 )
+        continue;
+      hists_[ptLead]->Fill( r, jet.pt(), weight );
+      hists_[eLead]->Fill( r, jet.E(), weight );
+      hists_[etaLead]->Fill( r, jet.eta(), weight );
+      hists_[nPartLead]->Fill( r, nConstituents_[r], weight );
+      if ( partons.size() >= 2 ) {
+        int p = partons[1].delta_R( jet ) < partons[0].delta_R( jet ) ? 1 : 0;
+        hists_[deltaR]->Fill( r, partons[p].delta_R( jet ), weight );
+        hists_[deltaE]->Fill( r, partons[p].E() - jet.E(), weight );
+      }
+    }
+
+    double elapsed = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+    timeHist_->Fill( elapsed );
+    time_ += elapsed;
+  }
+
+  // compare with the exact leading jet at radius index r
+  void validate( unsigned r, const fastjet::PseudoJet& exact, double weight ) {
+    if ( !enabled() || exact.pt2() <= 0 )
+      return;
+    const fastjet::PseudoJet& jet = leads_[r];
+    if ( jet.pt2() <= 0 ) {
+      hists_[valFound]->Fill( r, 0.0, weight );
+      return;
+    }
+    double dr = jet.delta_R( exact );
+    hists_[valFound]->Fill( r, dr < 0.5 * radii_[r] ? 1.0 : 0.0, weight );
+    hists_[valPtRatio]->Fill( r, jet.pt() / exact.pt(), weight );
+    hists_[valDR]->Fill( r, dr, weight );
+  }
+
+  // efficiency and resolutions per radius
+  void report() const {
+    if ( !enabled() )
+      return;
+    std::cout<<"fastlead: "<<time_ / 1000.0<<" s, validated on a fraction "<<fraction_<<" of the events"<<std::endl;
+    for ( unsigned r = 0; r < radii_.size(); ++r ) {
+      int bin = r + 1;
+      double missed = hists_[valFound]->GetBinContent( bin, 1 );
+      double found = hists_[valFound]->GetBinContent( bin, 2 );
+      if ( missed + found <= 0 )
+        continue;
+      TH1D* ratio = hists_[valPtRatio]->ProjectionY( "fastleadratio_py", bin, bin );
+      TH1D* dr = hists_[valDR]->ProjectionY( "fastleaddr_py", bin, bin );
+      std::cout<<"  R = "<<radii_[r]<<": efficiency "<<found / ( missed + found )
+               <<", pt ratio "<<ratio->GetMean()<<" +- "<<ratio->GetRMS()
+               <<", delta R "<<dr->GetMean()<<" +- "<<dr->GetRMS()<<std::endl;
+      delete ratio;
+      delete dr;
+    }
+  }
+
+  void write() {
+    if ( !enabled() )
+      return;
+    for ( unsigned k = 0; k < hists_.size(); ++k )
+      hists_[k]->Write();
+    timeHist_->Write();
+  }
+
+private:
+
+  enum Hist { ptLead = 0, eLead, etaLead, nPartLead, deltaR, deltaE, valFound, valPtRatio, valDR, nHists };
+  static const int maxIterations = 3;
+  static constexpr double stable = 1e-3;
+
+  // sum of the particles within R of ( rap, phi )
+  void coneSum( double R, double rap, double phi, fastjet::PseudoJet& sum, unsigned& count ) {
+    double R2 = R * R;
+    double px = 0, py = 0, pz = 0, e = 0;
+    unsigned n = 0;
+    unsigned size = pt_.size();
+    const double* y = &rap_[0];
+    const double* p = &phi_[0];
+    for ( unsigned i = 0; i < size; ++i ) {
+      double dy = y[i] - rap;
+      double dphi = std::fabs( p[i] - phi );
+      dphi = std::min( dphi, 2.0 * M_PI - dphi );
+      bool in = dy * dy + dphi * dphi < R2;
+      px += in ? px_[i] : 0.0;
+      py += in ? py_[i] : 0.0;
+      pz += in ? pz_[i] : 0.0;
+      e += in ? e_[i] : 0.0;
+      n += in;
+    }
+    sum = fastjet::PseudoJet( px, py, pz, e );
+    count = n;
+  }
+
+  // pt weighted centre of the hardest R x R cell
+  void gridSeed( double R, double& rap, double& phi ) {
+    int nPhi = std::max( (int) std::floor( 2.0 * M_PI / R ), 1 );
+    double phiWidth = 2.0 * M_PI / nPhi;
+    double rapMin = *std::min_element( rap_.begin(), rap_.end() );
+    int nRap = (int) std::floor( ( *std::max_element( rap_.begin(), rap_.end() ) - rapMin ) / R ) + 1;
+    cellPt_.assign( nRap * nPhi, 0.0 );
+    cellRap_.assign( nRap * nPhi, 0.0 );
+    cellPhi_.assign( nRap * nPhi, 0.0 );
+    for ( unsigned i = 0; i < pt_.size(); ++i ) {
+      int cell = (int) ( ( rap_[i] - rapMin ) / R ) * nPhi + std::min( (int) ( phi_[i] / phiWidth ), nPhi - 1 );
+      cellPt_[cell] += pt_[i];
+      cellRap_[cell] += pt_[i] * rap_[i];
+      cellPhi_[cell] += pt_[i] * phi_[i];
+    }
+    unsigned best = std::max_element( cellPt_.begin(), cellPt_.end() ) - cellPt_.begin();
+    if ( cellPt_[best] <= 0 )
+      return;
+    rap = cellRap_[best] / cellPt_[best];
+    phi = cellPhi_[best] / cellPt_[best];
+  }
+
+  Seed seed_;
+  double fraction_;
+  std::vector<double> radii_;
+  std::vector<fastjet::PseudoJet> leads_;
+  std::vector<unsigned> nConstituents_;
+  unsigned long sampled_;
+  double time_;
+  std::vector<TH2*> hists_;
+  TH1D* timeHist_;
+
+  std::vector<double> px_, py_, pz_, e_, pt_, rap_, phi_;
+  std::vector<double> cellPt_, cellRap_, cellPhi_;
+};
+
+#endif
@@ -47,8 +47,14 @@
 #include <chrono>
 #include <thread>
 
+#include "histSnapshot.hh"
+
 // only one argument: the input file
 // [1]: root file for input
+// or, to plot running jobs without stopping them:
+// [1]: live
+// [2+]: snapshot files of the jobs ( snapshot_file in
+//       jetFindAnalysis ), their histograms are summed
 
 
 int main ( int argc, const char** argv ) {
@@ -59,6 +65,7 @@ int main ( int argc, const char** argv ) {
   // get the input file name
   unsigned exponent;
   std::string inFile;
+  std::vector<std::string> snapshotFiles;
   
   switch ( argc ) {
     case 1: {
@@ -70,13 +77,35 @@ int main ( int argc, const char** argv ) {
       break;
     }
     default: {
-      std::cerr<<"Error: unexpected number of inputs."<<std::endl;
-      return -1;
+      if ( std::string( argv[1] ) != "live" ) {
+        std::cerr<<"Error: unexpected number of inputs."<<std::endl;
+        return -1;
+      }
+      snapshotFiles.assign( argv + 2, argv + argc );
+      break;
     }
   }
 
-  // load the root file where the histograms are stored
-  TFile rootFile( inFile.c_str(), "READ" );
+  // load the root file where the histograms are stored,
+  // or the latest snapshot of each running job
+  std::vector<TFile*> inputs;
+  std::vector<std::vector<char> > snapshotBuffers( snapshotFiles.size() );
+  if ( snapshotFiles.empty() )
+    inputs.push_back( new TFile( inFile.c_str(), "READ" ) );
+  for ( unsigned i = 0; i < snapshotFiles.size(); ++i ) {
+    unsigned long long events = 0;
+    double published = 0;
+    TMemFile* snapshot = readSnapshot( snapshotFiles[i], snapshotBuffers[i], events, published );
+    if ( !snapshot )
+      continue;
+    double age = std::chrono::duration<double>( std::chrono::system_clock::now().time_since_epoch() ).count() - published;
+    std::cout<<snapshotFiles[i]<<": "<<events<<" events, published "<<age<<" s ago"<<std::endl;
+    inputs.push_back( snapshot );
+  }
+  if ( inputs.empty() ) {
+    std::cerr<<"Error: no snapshots to plot."<<std::endl;
+    return -1;
+  }
   
   // Current histograms
   // ------------------
@@ -101,13 +130,15 @@ int main ( int argc, const char** argv ) {
   std::string radii[nRadii] = { "0.1", "0.2", "0.3", "0.4", "0.5", "0.6", "0.7", "0.8", "0.9", "1.0" };
   unsigned baseRad = 7;
   
-  // store the histograms in arrays of TH2Ds
-  TH2D* histograms[nJetFinders][nHistograms];
+  // store the histograms in arrays of TH2s, double or float
+  TH2* histograms[nJetFinders][nHistograms];
   
   // load histograms from file
   for ( int i = 0; i < nHistograms; ++i ) {
     for ( int j = 0; j < nJetFinders; ++j ) {
-      histograms[j][i] = (TH2D*) rootFile.Get( (jfNames[j]+histNames[i]).c_str() );
+      histograms[j][i] = (TH2*) inputs[0]->Get( (jfNames[j]+histNames[i]).c_str() );
+      for ( unsigned k = 1; k < inputs.size(); ++k )
+        histograms[j][i]->Add( (TH2*) inputs[k]->Get( (jfNames[j]+histNames[i]).c_str() ) );
     }
   }
   
@@ -0,0 +1,367 @@
+// streaming HepMC3 ascii input for jetFindAnalysis
+// Nick Elsey
+
+// reads HepMC3 Asciiv3 files as an alternative to pythia,
+// producing the same all / charged / parton vectors the sweep
+// makes from pythia events ( see jetFind.hh ):
+// - files ending in .gz or .zst are decompressed by a gzip or
+//   zstd child process, so no compression library is needed
+// - a reader thread parses events into a small ring of slots
+//   while the event loop clusters the previous ones. the slot
+//   vectors are swapped with the caller's, so after the first
+//   few events no memory is allocated
+// - lines are parsed in place with strtol / strtod
+// - partons are the two particles with status partonStatus
+//   ( 23 for pythia's outgoing hard partons ), final state
+//   particles have status 1. the charge is taken from the PDG id
+// - momenta are converted to GeV from the units of the U line,
+//   events in any unit other than GEV or MEV are rejected
+// - as with the sweep's parton acceptance, events whose partons
+//   are outside the acceptance come without partons, so the event
+//   loop skips them
+// - the first event weight ( W line ) is the event weight
+// throughput of the reader and the time the event loop spent
+// waiting on it are available from stats()
+
+#ifndef HEPMCREADER_HH
+#define HEPMCREADER_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "fastjet/PseudoJet.hh"
+
+// three times the charge of a particle, from its PDG id
+inline int pdgThreeCharge( int pid ) {
+  static const int quark[7] = { 0, -1, 2, -1, 2, -1, 2 };
+  int aid = std::abs( pid );
+  int charge = 0;
+  if ( aid <= 100 ) {
+    if ( aid <= 6 ) charge = quark[aid];
+    else if ( aid == 11 || aid == 13 || aid == 15 || aid == 17 ) charge = -3;
+    else if ( aid == 24 || aid == 37 ) charge = 3;
+  }
+  else if ( aid < 1000000000 ) {
+    int q3 = ( aid / 10 ) % 10;
+    int q2 = ( aid / 100 ) % 10;
+    int q1 = ( aid / 1000 ) % 10;
+    if ( q2 == 0 || q2 > 6 || q3 > 6 || q1 > 6 )
+      return 0;
+    if ( q1 == 0 ) {
+      if ( q3 == 0 )
+        return 0;
+      // mesons: the heavier quark sets the sign convention
+      charge = ( q2 == 3 || q2 == 5 ) ? quark[q3] - quark[q2] : quark[q2] - quark[q3];
+    }
+    else if ( q3 == 0 )
+      charge = quark[q1] + quark[q2];
+    else
+      charge = quark[q1] + quark[q2] + quark[q3];
+  }
+  return pid < 0 ? -charge : charge;
+}
+
+struct HepMCReaderStats {
+  unsigned long events;
+  double megabytes;
+  double parseSeconds;   // time the reader thread spent parsing
+  double waitSeconds;    // time the event loop spent waiting for input
+};
+
+class HepMCReader {
+public:
+
+  HepMCReader( const std::string& file, double maxRap, int partonStatus = 23, unsigned nSlots = 8 ) :
+  file_( file ), maxRap_( maxRap ), partonStatus_( partonStatus ), input_( 0 ), pipe_( false ),
+  slots_( nSlots < 2 ? 2 : nSlots ), head_( 0 ), filled_( 0 ), finished_( false ), stop_( false ),
+  bytes_( 0 ), events_( 0 ), parseSeconds_( 0 ), waitSeconds_( 0 ), line_( 0 ), lineCapacity_( 0 ) { }
+
+  ~HepMCReader() {
+    close();
+    free( line_ );
+  }
+
+  bool open() {
+    std::string command;
+    if ( endsWith( file_, ".gz" ) )
+      command = "gzip -dc '" + file_ + "'";
+    else if ( endsWith( file_, ".zst" ) )
+      command = "zstd -dc '" + file_ + "'";
+
+    if ( command.empty() )
+      input_ = fopen( file_.c_str(), "r" );
+    else
+      input_ = popen( command.c_str(), "r" );
+    pipe_ = !command.empty();
+    if ( !input_ ) {
+      std::cerr<<"Error: could not open HepMC file "<<file_<<std::endl;
+      return false;
+    }
+    setvbuf( input_, 0, _IOFBF, 1 << 22 );
+    thread_ = std::thread( &HepMCReader::readLoop, this );
+    return true;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      stop_ = true;
+    }
+    changed_.notify_all();
+    if ( thread_.joinable() )
+      thread_.join();
+    if ( input_ ) {
+      if ( pipe_ ) pclose( input_ );
+      else fclose( input_ );
+      input_ = 0;
+    }
+  }
+
+  // get the next event, returns false at the end of the file
+  // the vectors are swapped with the reader's internal storage
+  bool next( std::vector<fastjet::PseudoJet>& all, std::vector<fastjet::PseudoJet>& charged,
+             std::vector<fastjet::PseudoJet>& part, double& weight ) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock( mutex_ );
+    changed_.wait( lock, [this]() { return filled_ > 0 || finished_; } );
+    waitSeconds_ += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    if ( filled_ == 0 )
+      return false;
+
+    Slot& slot = slots_[head_];
+    all.swap( slot.all );
+    charged.swap( slot.charged );
+    part.swap( slot.part );
+    weight = slot.weight;
+    head_ = ( head_ + 1 ) % slots_.size();
+    filled_--;
+    lock.unlock();
+    changed_.notify_all();
+    return true;
+  }
+
+  HepMCReaderStats stats() const {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    HepMCReaderStats s = { events_, bytes_ / 1048576.0, parseSeconds_, waitSeconds_ };
+    return s;
+  }
+
+private:
+
+  struct Slot {
+    std::vector<fastjet::PseudoJet> all;
+    std::vector<fastjet::PseudoJet> charged;
+    std::vector<fastjet::PseudoJet> part;
+    double weight;
+  };
+
+  static bool endsWith( const std::string& s, const std::string& end ) {
+    return s.size() >= end.size() && s.compare( s.size() - end.size(), end.size(), end ) == 0;
+  }
+
+  // reads the next line into line_, returns its length or -1
+  ssize_t readLine() {
+    ssize_t n = getline( &line_, &lineCapacity_, input_ );
+    if ( n > 0 )
+      readBytes_ += n;
+    return n;
+  }
+
+  // parse one event into slot, starting after its E line
+  // returns false at the end of the input
+  bool parseEvent( Slot& slot ) {
+    slot.all.clear();
+    slot.charged.clear();
+    slot.part.clear();
+    slot.weight = 1.0;
+    bool haveEvent = false;
+    momentumScale_ = 1.0;
+    badUnits_ = false;
+
+    while ( true ) {
+      // the E line of the next event ends this one
+      // ( pending_ stays set, so the next call starts with it )
+      if ( pending_ ) {
+        if ( haveEvent )
+          return finishEvent( slot );
+        pending_ = false;
+        haveEvent = true;
+        continue;
+      }
+      ssize_t n = readLine();
+      if ( n < 0 )
+        return haveEvent && finishEvent( slot );
+      if ( n < 2 || line_[1] != ' ' )
+        continue;
+      switch ( line_[0] ) {
+        case 'E': {
+          pending_ = true;
+          break;
+        }
+        case 'U': {
+          if ( haveEvent )
+            parseUnits();
+          break;
+        }
+        case 'W': {
+          if ( haveEvent )
+            slot.weight = strtod( line_ + 2, 0 );
+          break;
+        }
+        case 'P': {
+          if ( haveEvent )
+            parseParticle( slot );
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+
+  // U momentum_unit length_unit
+  void parseUnits() {
+    char unit[16] = "";
+    sscanf( line_ + 2, "%15s", unit );
+    if ( strcmp( unit, "GEV" ) == 0 )
+      momentumScale_ = 1.0;
+    else if ( strcmp( unit, "MEV" ) == 0 )
+      momentumScale_ = 0.001;
+    else {
+      if ( !unitsWarned_ )
+        std::cerr<<"Error: unknown momentum unit "<<unit<<" in "<<file_<<", skipping those events"<<std::endl;
+      unitsWarned_ = true;
+      badUnits_ = true;
+    }
+  }
+
+  // events in unknown units, or with a parton outside the
+  // acceptance, keep no partons. always true, the event was read
+  bool finishEvent( Slot& slot ) {
+    bool partonsOut = slot.part.size() == 2 &&
+                      ( std::fabs( slot.part[0].eta() ) > maxRap_ || std::fabs( slot.part[1].eta() ) > maxRap_ );
+    if ( badUnits_ || partonsOut ) {
+      slot.part.clear();
+      if ( badUnits_ ) {
+        slot.all.clear();
+        slot.charged.clear();
+      }
+    }
+    return true;
+  }
+
+  // P id parent_vertex pdg px py pz e m status
+  void parseParticle( Slot& slot ) {
+    char* c = line_ + 2;
+    strtol( c, &c, 10 );
+    strtol( c, &c, 10 );
+    int pdg = strtol( c, &c, 10 );
+    double px = strtod( c, &c );
+    double py = strtod( c, &c );
+    double pz = strtod( c, &c );
+    double e = strtod( c, &c );
+    strtod( c, &c );
+    int status = strtol( c, &c, 10 );
+    px *= momentumScale_;
+    py *= momentumScale_;
+    pz *= momentumScale_;
+    e *= momentumScale_;
+
+    if ( status == partonStatus_ ) {
+      if ( slot.part.size() < 2 ) {
+        fastjet::PseudoJet parton( px, py, pz, e );
+        parton.set_user_index( pdgThreeCharge( pdg ) );
+        slot.part.push_back( parton );
+      }
+      return;
+    }
+    if ( status != 1 )
+      return;
+    int aid = std::abs( pdg );
+    if ( aid == 12 || aid == 14 || aid == 16 || aid == 1000022 || aid == 1000039 )
+      return;
+    fastjet::PseudoJet tmp( px, py, pz, e );
+    if ( std::fabs( tmp.rap() ) > maxRap_ )
+      return;
+    int charge = pdgThreeCharge( pdg ) / 3;
+    tmp.set_user_index( charge );
+    slot.all.push_back( tmp );
+    if ( charge )
+      slot.charged.push_back( tmp );
+  }
+
+  void readLoop() {
+    pending_ = false;
+    readBytes_ = 0;
+    unitsWarned_ = false;
+    Slot scratch;
+    while ( true ) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      bool ok = parseEvent( scratch );
+      double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+      std::unique_lock<std::mutex> lock( mutex_ );
+      parseSeconds_ += elapsed;
+      bytes_ = readBytes_;
+      if ( !ok ) {
+        finished_ = true;
+        break;
+      }
+      changed_.wait( lock, [this]() { return filled_ < slots_.size() || stop_; } );
+      if ( stop_ ) {
+        finished_ = true;
+        break;
+      }
+      Slot& slot = slots_[( head_ + filled_ ) % slots_.size()];
+      slot.all.swap( scratch.all );
+      slot.charged.swap( scratch.charged );
+      slot.part.swap( scratch.part );
+      slot.weight = scratch.weight;
+      filled_++;
+      events_++;
+      lock.unlock();
+      changed_.notify_all();
+    }
+    changed_.notify_all();
+  }
+
+  std::string file_;
+  double maxRap_;
+  int partonStatus_;
+  FILE* input_;
+  bool pipe_;
+  bool pending_;
+  unsigned long long readBytes_;
+  double momentumScale_;
+  bool badUnits_;
+  bool unitsWarned_;
+
+  std::vector<Slot> slots_;
+  unsigned head_;
+  unsigned filled_;
+  bool finished_;
+  bool stop_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread thread_;
+
+  unsigned long long bytes_;
+  unsigned long events_;
+  double parseSeconds_;
+  double waitSeconds_;
+
+  char* line_;
+  size_t lineCapacity_;
+};
+
+#endif
@@ -0,0 +1,300 @@
+// live histogram snapshots of a running analysis
+// Nick Elsey
+
+// a running job only writes its histograms at exit. with
+// snapshot_file set, it also publishes every histogram it holds
+// in memory into a memory-mapped file ( put it in /dev/shm for
+// POSIX shared memory ) every snapshot_interval seconds, where
+// generate_output live can read it without disturbing the job.
+//
+// the file is a header followed by two slots, each holding one
+// complete ROOT file image ( a TMemFile ):
+// - the writer always fills the slot that is not active, then
+//   makes it active. the generation counter is odd while a slot
+//   is being written and even otherwise
+// - a reader copies the active slot and checks the generation
+//   afterwards. the copy is good unless the writer has since
+//   started writing into that same slot, then it simply retries
+// nobody ever waits on a lock, so the event loop never blocks on
+// a reader.
+//
+// the slots are sized from the uncompressed size of the histograms,
+// an upper bound that does not grow as they fill. should an image
+// still not fit, the slot to be written is moved to new space at
+// the end of the file, with twice the room; the active slot is not
+// touched, and readers map the file again when a slot lies beyond
+// their mapping. the serialization itself runs in the event loop,
+// since ROOT histograms can not be read while they are filled,
+// and costs one TMemFile write per interval
+
+#ifndef HISTSNAPSHOT_HH
+#define HISTSNAPSHOT_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "TH1.h"
+#include "TList.h"
+#include "TDirectory.h"
+#include "TMemFile.h"
+
+#include "histStorage.hh"
+
+struct SnapshotHeader {
+  char magic[8];
+  std::atomic<unsigned long long> generation;
+  std::atomic<unsigned long long> active;
+  unsigned long long offset[2];     // start of each slot in the file
+  unsigned long long capacity[2];   // bytes available in each slot
+  unsigned long long size[2];       // bytes used in each slot
+  unsigned long long events[2];     // events processed at publication
+  double published[2];              // publication time, seconds since the epoch
+};
+
+const char snapshotMagic[8] = "JFSNAP2";
+const unsigned long long snapshotHeaderBytes = 4096;
+
+class HistSnapshotWriter {
+public:
+
+  // publishes the histograms held by dir, nothing if file is empty
+  HistSnapshotWriter( TDirectory* dir, const std::string& file, double interval ) :
+  dir_( dir ), file_( file ), interval_( interval ), map_( 0 ), mapBytes_( 0 ),
+  last_( std::chrono::steady_clock::now() ) { }
+
+  ~HistSnapshotWriter() {
+    if ( map_ )
+      munmap( map_, mapBytes_ );
+  }
+
+  // publish if the interval has passed
+  void update( unsigned long long events ) {
+    if ( file_.empty() )
+      return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if ( std::chrono::duration<double>( now - last_ ).count() < interval_ )
+      return;
+    last_ = now;
+    publish( events );
+  }
+
+  void publish( unsigned long long events ) {
+    if ( file_.empty() )
+      return;
+
+    // opening the TMemFile makes it the current directory
+    TDirectory* saved = gDirectory;
+    TMemFile image( "snapshot.root", "RECREATE" );
+    TList* list = dir_->GetList();
+    for ( int i = 0; i < list->GetSize(); ++i ) {
+      TH1* h = dynamic_cast<TH1*>( list->At( i ) );
+      if ( h )
+        image.WriteTObject( h );
+    }
+    image.Write();
+    unsigned long long size = image.GetSize();
+    saved->cd();
+
+    // the slots are sized on the first snapshot, for the
+    // histograms without compression
+    if ( !map_ && !create( std::max( 2 * size, uncompressedBound() ) ) ) {
+      file_.clear();
+      return;
+    }
+    SnapshotHeader* header = static_cast<SnapshotHeader*>( map_ );
+    unsigned long long target = 1 - header->active.load( std::memory_order_relaxed );
+    header->generation.fetch_add( 1, std::memory_order_acq_rel );
+    if ( size > header->capacity[target] ) {
+      if ( !grow( target, 2 * size ) ) {
+        // the active slot is still good, readers keep getting it
+        header->generation.fetch_add( 1, std::memory_order_release );
+        file_.clear();
+        return;
+      }
+      header = static_cast<SnapshotHeader*>( map_ );
+    }
+    image.CopyTo( static_cast<char*>( map_ ) + header->offset[target], size );
+    header->size[target] = size;
+    header->events[target] = events;
+    header->published[target] = std::chrono::duration<double>( std::chrono::system_clock::now().time_since_epoch() ).count();
+    header->active.store( target, std::memory_order_release );
+    header->generation.fetch_add( 1, std::memory_order_release );
+  }
+
+private:
+
+  // bytes of the histograms held by dir when stored uncompressed,
+  // plus room for the keys, names and streamer info
+  unsigned long long uncompressedBound() const {
+    double bytes = 1 << 20;
+    TList* list = dir_->GetList();
+    for ( int i = 0; i < list->GetSize(); ++i ) {
+      const TH1* h = dynamic_cast<const TH1*>( list->At( i ) );
+      if ( h )
+        bytes += histogramBytes( h ) + 4096;
+    }
+    return bytes;
+  }
+
+  bool create( unsigned long long capacity ) {
+    int fd = open( file_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 ) {
+      std::cerr<<"Error: could not create histogram snapshot file "<<file_<<std::endl;
+      return false;
+    }
+    mapBytes_ = snapshotHeaderBytes + 2 * capacity;
+    if ( ftruncate( fd, mapBytes_ ) != 0 ) {
+      std::cerr<<"Error: could not size histogram snapshot file "<<file_<<std::endl;
+      ::close( fd );
+      return false;
+    }
+    void* map = mmap( 0, mapBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( map == MAP_FAILED ) {
+      std::cerr<<"Error: could not map histogram snapshot file "<<file_<<std::endl;
+      return false;
+    }
+    map_ = map;
+
+    SnapshotHeader* header = new ( map_ ) SnapshotHeader;
+    header->generation.store( 0 );
+    header->active.store( 1 );
+    for ( int i = 0; i < 2; ++i ) {
+      header->offset[i] = snapshotHeaderBytes + i * capacity;
+      header->capacity[i] = capacity;
+      header->size[i] = 0;
+      header->events[i] = 0;
+      header->published[i] = 0;
+    }
+    // the magic goes in last, a reader ignores the file until then
+    std::atomic_thread_fence( std::memory_order_release );
+    std::memcpy( header->magic, snapshotMagic, sizeof( snapshotMagic ) );
+    return true;
+  }
+
+  // give slot i capacity bytes at the end of the file. the other
+  // slot, which readers may be copying, stays where it is
+  bool grow( unsigned long long i, unsigned long long capacity ) {
+    unsigned long long offset = mapBytes_;
+    unsigned long long bytes = mapBytes_ + capacity;
+    int fd = open( file_.c_str(), O_RDWR );
+    if ( fd < 0 || ftruncate( fd, bytes ) != 0 ) {
+      std::cerr<<"Error: could not grow histogram snapshot file "<<file_<<std::endl;
+      if ( fd >= 0 )
+        ::close( fd );
+      return false;
+    }
+    void* map = mmap( 0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( map == MAP_FAILED ) {
+      std::cerr<<"Error: could not map histogram snapshot file "<<file_<<std::endl;
+      return false;
+    }
+    munmap( map_, mapBytes_ );
+    map_ = map;
+    mapBytes_ = bytes;
+    SnapshotHeader* header = static_cast<SnapshotHeader*>( map_ );
+    header->offset[i] = offset;
+    header->capacity[i] = capacity;
+    std::cout<<"snapshot: grew "<<file_<<" to "<<bytes / ( 1024.0 * 1024.0 )<<" MB"<<std::endl;
+    return true;
+  }
+
+  TDirectory* dir_;
+  std::string file_;
+  double interval_;
+  void* map_;
+  unsigned long long mapBytes_;
+  std::chrono::steady_clock::time_point last_;
+};
+
+// one mapping of file, sets remap when the active slot lies
+// beyond it
+inline TMemFile* readSnapshotOnce( const std::string& file, std::vector<char>& buffer,
+                                   unsigned long long& events, double& published, bool& remap ) {
+  int fd = open( file.c_str(), O_RDONLY );
+  if ( fd < 0 ) {
+    std::cerr<<"Error: could not open histogram snapshot file "<<file<<std::endl;
+    return 0;
+  }
+  struct stat info;
+  if ( fstat( fd, &info ) != 0 || (unsigned long long) info.st_size < snapshotHeaderBytes ) {
+    std::cerr<<"Error: "<<file<<" is not a histogram snapshot file"<<std::endl;
+    ::close( fd );
+    return 0;
+  }
+  unsigned long long mapBytes = info.st_size;
+  void* map = mmap( 0, mapBytes, PROT_READ, MAP_SHARED, fd, 0 );
+  ::close( fd );
+  if ( map == MAP_FAILED ) {
+    std::cerr<<"Error: could not map histogram snapshot file "<<file<<std::endl;
+    return 0;
+  }
+
+  const SnapshotHeader* header = static_cast<const SnapshotHeader*>( map );
+  TMemFile* result = 0;
+  if ( std::memcmp( header->magic, snapshotMagic, sizeof( snapshotMagic ) ) != 0 ) {
+    std::cerr<<"Error: "<<file<<" is not a histogram snapshot file"<<std::endl;
+  }
+  else {
+    for ( int attempt = 0; attempt < 100; ++attempt ) {
+      unsigned long long first = header->generation.load( std::memory_order_acquire );
+      if ( first < 2 )
+        break;
+      unsigned long long active = header->active.load( std::memory_order_acquire );
+      unsigned long long size = header->size[active];
+      unsigned long long offset = header->offset[active];
+      if ( size > header->capacity[active] || offset + size > mapBytes ) {
+        remap = true;
+        break;
+      }
+      buffer.resize( size );
+      std::memcpy( &buffer[0], static_cast<const char*>( map ) + offset, size );
+      events = header->events[active];
+      published = header->published[active];
+      std::atomic_thread_fence( std::memory_order_acquire );
+      // the writer starts on this slot again only after it has
+      // finished the other one
+      unsigned long long last = header->generation.load( std::memory_order_acquire );
+      if ( last <= ( ( first + 2 ) & ~1ULL ) ) {
+        result = new TMemFile( file.c_str(), &buffer[0], size, "READ" );
+        break;
+      }
+    }
+    if ( !result && !remap )
+      std::cerr<<"Error: no complete snapshot in "<<file<<" yet"<<std::endl;
+  }
+  munmap( map, mapBytes );
+  return result;
+}
+
+// copy the latest complete snapshot out of file into buffer and
+// open it as an in-memory ROOT file, which the caller owns. buffer
+// has to outlive the returned file. returns 0 if there is no
+// snapshot yet or file is not a snapshot file
+inline TMemFile* readSnapshot( const std::string& file, std::vector<char>& buffer,
+                               unsigned long long& events, double& published ) {
+  // a slot beyond the mapping means the writer grew the file,
+  // map it again
+  for ( int mapping = 0; mapping < 3; ++mapping ) {
+    bool remap = false;
+    TMemFile* result = readSnapshotOnce( file, buffer, events, published, remap );
+    if ( !remap )
+      return result;
+  }
+  std::cerr<<"Error: no complete snapshot in "<<file<<" yet"<<std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,108 @@
+// histogram storage for the radius sweep
+// Nick Elsey
+
+// every per radius histogram has one column per radius, so a
+// finer sweep grows them linearly. two things keep that in check:
+// - hist_precision=float makes them TH2F, half the memory of a
+//   TH2D. a float bin counts exactly up to 2^24 unit entries, so
+//   keep double for very long runs
+// - the sum of squared weights doubles the storage again, and only
+//   carries information when events are weighted. main enables
+//   TH1::SetDefaultSumw2 only then, histograms filled with values
+//   other than the event weight ( the correlators ) call
+//   requireSumw2 themselves
+// reportHistogramMemory then prints what the sweep costs, per
+// radius configuration and in total
+
+#ifndef HISTSTORAGE_HH
+#define HISTSTORAGE_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "TH1.h"
+#include "TH2.h"
+#include "TProfile.h"
+#include "TProfile2D.h"
+#include "TList.h"
+#include "TDirectory.h"
+
+inline bool& floatRadiusHists() {
+  static bool useFloat = false;
+  return useFloat;
+}
+
+// "double" or "float"
+inline bool setHistPrecision( const std::string& precision ) {
+  if ( precision != "double" && precision != "float" ) {
+    std::cerr<<"Error: unknown hist_precision "<<precision<<", use double or float"<<std::endl;
+    return false;
+  }
+  floatRadiusHists() = precision == "float";
+  return true;
+}
+
+// a histogram with one x bin per radius, in the chosen precision
+inline TH2* newRadiusHist( const char* name, const char* title, int nx, double xlow, double xup,
+                           int ny, double ylow, double yup ) {
+  if ( floatRadiusHists() )
+    return new TH2F( name, title, nx, xlow, xup, ny, ylow, yup );
+  return new TH2D( name, title, nx, xlow, xup, ny, ylow, yup );
+}
+
+inline TH2* newRadiusHist( const char* name, const char* title, int nx, double xlow, double xup,
+                           int ny, const double* yedges ) {
+  if ( floatRadiusHists() )
+    return new TH2F( name, title, nx, xlow, xup, ny, yedges );
+  return new TH2D( name, title, nx, xlow, xup, ny, yedges );
+}
+
+// errors on a histogram whose fills are not plain event weights
+inline void requireSumw2( TH1* h ) {
+  if ( h->GetSumw2N() == 0 )
+    h->Sumw2();
+}
+
+// bytes held by the bins of h
+inline double histogramBytes( const TH1* h ) {
+  double cells = h->GetNcells();
+  double bytes = cells * ( dynamic_cast<const TH2F*>( h ) || dynamic_cast<const TH1F*>( h ) ? 4 : 8 );
+  bytes += 8.0 * h->GetSumw2N();
+  // profiles keep the entries and their squared weights per bin
+  if ( dynamic_cast<const TProfile*>( h ) || dynamic_cast<const TProfile2D*>( h ) )
+    bytes += 2 * 8.0 * cells;
+  return bytes;
+}
+
+// print the memory of the histograms in dir, split into those
+// with one column per radius ( nRadii x bins labelled with the
+// radius labels ) and the rest
+inline void reportHistogramMemory( TDirectory* dir, const std::vector<std::string>& radiusLabels ) {
+  double sweepBytes = 0, otherBytes = 0;
+  unsigned nSweep = 0, nOther = 0;
+  TList* list = dir->GetList();
+  for ( int i = 0; i < list->GetSize(); ++i ) {
+    const TH1* h = dynamic_cast<const TH1*>( list->At( i ) );
+    if ( !h )
+      continue;
+    bool sweep = h->GetDimension() == 2 && h->GetXaxis()->GetNbins() == (int) radiusLabels.size() &&
+                 radiusLabels[0] == h->GetXaxis()->GetBinLabel( 1 );
+    if ( sweep ) {
+      sweepBytes += histogramBytes( h );
+      nSweep++;
+    }
+    else {
+      otherBytes += histogramBytes( h );
+      nOther++;
+    }
+  }
+  double mb = 1024.0 * 1024.0;
+  std::cout<<"histogram memory: "<<( sweepBytes + otherBytes ) / mb<<" MB in "<<nSweep + nOther<<" histograms"<<std::endl;
+  std::cout<<"  radius sweep:     "<<sweepBytes / mb<<" MB in "<<nSweep<<" histograms, "
+           <<sweepBytes / radiusLabels.size() / 1024.0<<" kB per radius ( "<<radiusLabels.size()<<" radii, "
+           <<( floatRadiusHists() ? "float" : "double" )<<", "<<( TH1::GetDefaultSumw2() ? "with" : "without" )<<" sumw2 )"<<std::endl;
+  std::cout<<"  fixed:            "<<otherBytes / mb<<" MB in "<<nOther<<" histograms"<<std::endl;
+}
+
+#endif
@@ -0,0 +1,224 @@
+// energy correlators of the leading jets
+// Nick Elsey
+
+// fills, for every jetfinder and radius, the leading jet's
+// - <jetfinder>eec : two point correlator, sum over ordered pairs
+//   i != j of pt_i pt_j / pt_jet^2 at their delta R
+// - <jetfinder>e3c : projected three point correlator, sum over
+//   all ordered triples ( repeated particles included, except
+//   i = j = k ) of pt_i pt_j pt_k / pt_jet^3 at the largest of
+//   their three delta R
+// in log spaced delta R bins, one histogram entry per jet and bin.
+// the cost is kept well below the clustering:
+// - the real constituents come from the clustering's JetMembership
+//   ( see jetMembership.hh ), so no jet history is walked here. they
+//   are copied into flat pt / rap / phi arrays, and the pair
+//   distances are computed in plain loops over them that the
+//   compiler vectorizes
+// - each pair is binned once. the binning is monotonic in delta R,
+//   so the triple loop only takes the largest of three bin indices
+//   and never evaluates a distance or a logarithm
+// - the radius sweep goes from small to large radius, and the
+//   leading jet often does not change between neighbouring radii.
+//   when it has the same momentum and number of constituents as for
+//   the previous radius the previous result is filled again, before
+//   any constituent is read
+// the time spent here is recorded per event as a fraction of the
+// event processing time in eectimefrac
+
+#ifndef JETEEC_HH
+#define JETEEC_HH
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "TH1.h"
+#include "TH2.h"
+
+#include "histStorage.hh"
+#include "jetMembership.hh"
+
+class JetEEC {
+public:
+
+  // maxN is the highest correlator computed: 2, 3, or 0 for none
+  JetEEC( const std::vector<std::string>& jetfinders, const std::vector<std::string>& radiusLabels, int maxN ) :
+  maxN_( maxN ), cache_( jetfinders.size() ), time_( 0 ), fraction_( 0 ) {
+    if ( maxN_ < 2 )
+      return;
+    double edges[nBins+1];
+    for ( int i = 0; i <= nBins; ++i )
+      edges[i] = std::pow( 10.0, logMin + i * logWidth );
+
+    int nRadii = radiusLabels.size();
+    for ( unsigned i = 0; i < jetfinders.size(); ++i ) {
+      eec_.push_back( newRadiusHist( ( jetfinders[i] + "eec" ).c_str(), ( "Lead Jet EEC - " + jetfinders[i] ).c_str(),
+                                nRadii, -0.5, nRadii - 0.5, nBins, edges ) );
+      if ( maxN_ >= 3 )
+        e3c_.push_back( newRadiusHist( ( jetfinders[i] + "e3c" ).c_str(), ( "Lead Jet Projected E3C - " + jetfinders[i] ).c_str(),
+                                  nRadii, -0.5, nRadii - 0.5, nBins, edges ) );
+      // filled with the correlator weights, not event weights
+      requireSumw2( eec_.back() );
+      if ( maxN_ >= 3 )
+        requireSumw2( e3c_.back() );
+      for ( int j = 0; j < nRadii; ++j ) {
+        eec_.back()->GetXaxis()->SetBinLabel( j+1, radiusLabels[j].c_str() );
+        if ( maxN_ >= 3 )
+          e3c_.back()->GetXaxis()->SetBinLabel( j+1, radiusLabels[j].c_str() );
+      }
+    }
+    fraction_ = new TH1D( "eectimefrac", "EEC Time / Event Processing Time", 100, 0, 1 );
+  }
+
+  bool enabled() const { return maxN_ >= 2; }
+
+  // correlators of jet, the leading jet of jetfinder at radius,
+  // which is jet 0 of members
+  void fill( unsigned jetfinder, unsigned radius, const JetMembership& members, const fastjet::PseudoJet& jet, double weight ) {
+    if ( !enabled() )
+      return;
+    typedef std::chrono::high_resolution_clock clock;
+    std::chrono::time_point<clock> start = clock::now();
+
+    Result& result = cache_[jetfinder];
+    unsigned n = members.real( 0 );
+    if ( !result.valid || n != result.n || jet.px() != result.px || jet.py() != result.py ||
+         jet.pz() != result.pz || jet.E() != result.e ) {
+      result.valid = true;
+      result.n = n;
+      result.px = jet.px();
+      result.py = jet.py();
+      result.pz = jet.pz();
+      result.e = jet.E();
+      compute( members, jet.pt(), result );
+    }
+
+    for ( int b = 0; b < nBins; ++b ) {
+      if ( result.eec[b+1] )
+        eec_[jetfinder]->Fill( radius, center( b ), result.eec[b+1] * weight );
+      if ( maxN_ >= 3 && result.e3c[b+1] )
+        e3c_[jetfinder]->Fill( radius, center( b ), result.e3c[b+1] * weight );
+    }
+    time_ += std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+  }
+
+  // record this event's share of the time, eventTime in ms
+  void endEvent( double eventTime ) {
+    if ( !enabled() )
+      return;
+    if ( eventTime > 0 )
+      fraction_->Fill( time_ / eventTime );
+    time_ = 0;
+    for ( unsigned i = 0; i < cache_.size(); ++i )
+      cache_[i].valid = false;
+  }
+
+  void write() {
+    for ( unsigned i = 0; i < eec_.size(); ++i )
+      eec_[i]->Write();
+    for ( unsigned i = 0; i < e3c_.size(); ++i )
+      e3c_[i]->Write();
+    if ( fraction_ )
+      fraction_->Write();
+  }
+
+private:
+
+  // log10 delta R from 10^-3 to 10^0.5, with under and overflow
+  static const int nBins = 50;
+  static constexpr double logMin = -3.0;
+  static constexpr double logWidth = 3.5 / nBins;
+
+  struct Result {
+    bool valid;
+    unsigned n;
+    double px, py, pz, e;
+    std::vector<double> eec;
+    std::vector<double> e3c;
+    Result() : valid( false ), n( 0 ), px( 0 ), py( 0 ), pz( 0 ), e( 0 ) { }
+  };
+
+  static double center( int b ) { return std::pow( 10.0, logMin + ( b + 0.5 ) * logWidth ); }
+
+  void compute( const JetMembership& members, double jetPt, Result& result ) {
+    result.eec.assign( nBins + 2, 0.0 );
+    result.e3c.assign( nBins + 2, 0.0 );
+
+    // flat arrays of the real constituents of jet 0
+    const std::vector<const fastjet::PseudoJet*>& inputs = members.inputs();
+    pt_.clear();
+    rap_.clear();
+    phi_.clear();
+    for ( unsigned i = members.begin( 0 ); i < members.end( 0 ); ++i ) {
+      pt_.push_back( inputs[i]->pt() / jetPt );
+      rap_.push_back( inputs[i]->rap() );
+      phi_.push_back( inputs[i]->phi() );
+    }
+    unsigned n = pt_.size();
+    if ( n < 2 )
+      return;
+
+    // pair distances, one row at a time, then their bins
+    dr2_.resize( n );
+    bins_.resize( n * n );
+    const double* pt = &pt_[0];
+    const double* rap = &rap_[0];
+    const double* phi = &phi_[0];
+    double* dr2 = &dr2_[0];
+    for ( unsigned i = 0; i + 1 < n; ++i ) {
+      for ( unsigned j = i + 1; j < n; ++j ) {
+        double dy = rap[i] - rap[j];
+        double dphi = std::fabs( phi[i] - phi[j] );
+        dphi = std::min( dphi, 2.0 * M_PI - dphi );
+        dr2[j] = dy * dy + dphi * dphi;
+      }
+      int* bins = &bins_[i * n];
+      for ( unsigned j = i + 1; j < n; ++j ) {
+        int b = dr2[j] > 0 ? (int) std::floor( ( 0.5 * std::log10( dr2[j] ) - logMin ) / logWidth ) + 1 : 0;
+        b = std::max( 0, std::min( b, nBins + 1 ) );
+        bins[j] = b;
+        double w = pt[i] * pt[j];
+        result.eec[b] += 2.0 * w;
+        // triples with a repeated particle: ( i, i, j ) and ( i, j, j )
+        // in their three orderings each
+        result.e3c[b] += 3.0 * w * ( pt[i] + pt[j] );
+      }
+    }
+    if ( maxN_ < 3 )
+      return;
+
+    // distinct triples i < j < k in their six orderings
+    for ( unsigned i = 0; i + 2 < n; ++i ) {
+      const int* binsI = &bins_[i * n];
+      for ( unsigned j = i + 1; j + 1 < n; ++j ) {
+        const int* binsJ = &bins_[j * n];
+        double wij = 6.0 * pt[i] * pt[j];
+        int bij = binsI[j];
+        for ( unsigned k = j + 1; k < n; ++k ) {
+          int b = std::max( bij, std::max( binsI[k], binsJ[k] ) );
+          result.e3c[b] += wij * pt[k];
+        }
+      }
+    }
+  }
+
+  int maxN_;
+  std::vector<TH2*> eec_;
+  std::vector<TH2*> e3c_;
+  std::vector<Result> cache_;
+  double time_;
+  TH1D* fraction_;
+
+  std::vector<double> pt_;
+  std::vector<double> rap_;
+  std::vector<double> phi_;
+  std::vector<double> dr2_;
+  std::vector<int> bins_;
+};
+
+#endif
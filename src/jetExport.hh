@@ -0,0 +1,337 @@
+// streaming export of the jets to a pipe or unix socket
+// Nick Elsey
+
+// with export_target set, the jets of every clustered event are
+// sent to an online consumer while the job runs:
+//   export_target=/tmp/jets.fifo     a named pipe, made if missing
+//   export_target=unix:/tmp/jets.sock a listening unix stream socket
+// the event loop serializes each event into a reused buffer and
+// hands it to a single producer / single consumer ring of
+// export_queue slots ( buffers are swapped, not copied ), and an
+// I/O thread writes them out. when the ring is full
+//   export_policy=drop   the event is dropped and counted
+//   export_policy=block  the event loop waits, so a slow consumer
+//                        throttles the analysis
+// while no consumer is connected the I/O thread retries every
+// 100 ms; with drop the queued events are dropped meanwhile. a
+// consumer that goes away is waited for again in the same way.
+//
+// framing, native byte order ( little endian on our machines ):
+//   frame   : uint32 magic, uint32 payload bytes, payload
+//   stream  : magic "JFS1", sent first on every connection
+//             uint16 nJetfinders, per jetfinder uint8 length + name
+//             uint16 nRadii, per radius float R
+//   event   : magic "JFE1"
+//             uint64 event, double weight, uint16 nSets, per set
+//               uint8 jetfinder, uint16 radius index, uint16 nJets,
+//               per jet float pt, eta, phi, mass, area,
+//                       uint16 real ( non ghost ) constituents
+// the jets are those above export_ptmin, by decreasing pt. the
+// records, bytes, drops and throttle time are printed at the end
+// and stored as exportstats
+
+#ifndef JETEXPORT_HH
+#define JETEXPORT_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "TH1.h"
+
+#include "jetMembership.hh"
+
+class JetExport {
+public:
+
+  JetExport( const std::string& target, const std::string& policy, unsigned queueSize, double ptMin,
+             const std::vector<std::string>& jetfinders, const std::vector<double>& radii ) :
+  target_( target ), socket_( false ), block_( policy == "block" ), ptMin_( ptMin ), slots_( std::max( queueSize, 2u ) ),
+  head_( 0 ), tail_( 0 ), stop_( false ), fd_( -1 ), nSets_( 0 ), setsPos_( 0 ),
+  events_( 0 ), written_( 0 ), dropped_( 0 ), bytes_( 0 ), connections_( 0 ), throttle_( 0 ), elapsed_( 0 ) {
+    if ( target_.empty() )
+      return;
+    if ( policy != "drop" && policy != "block" )
+      std::cerr<<"Warning: unknown export_policy "<<policy<<", using drop"<<std::endl;
+    socket_ = target_.compare( 0, 5, "unix:" ) == 0;
+    path_ = socket_ ? target_.substr( 5 ) : target_;
+    if ( !socket_ ) {
+      struct stat info;
+      if ( stat( path_.c_str(), &info ) != 0 && mkfifo( path_.c_str(), 0644 ) != 0 )
+        std::cerr<<"Error: could not make the pipe "<<path_<<std::endl;
+    }
+    // a consumer that goes away should end in a failed write, not
+    // in the end of the job
+    std::signal( SIGPIPE, SIG_IGN );
+
+    // the stream header, sent on every connection
+    begin( "JFS1" );
+    put<uint16_t>( jetfinders.size() );
+    for ( unsigned i = 0; i < jetfinders.size(); ++i ) {
+      put<uint8_t>( jetfinders[i].size() );
+      pending_.insert( pending_.end(), jetfinders[i].begin(), jetfinders[i].end() );
+    }
+    put<uint16_t>( radii.size() );
+    for ( unsigned i = 0; i < radii.size(); ++i )
+      put<float>( radii[i] );
+    finishFrame();
+    header_.swap( pending_ );
+
+    start_ = clock::now();
+    thread_ = std::thread( &JetExport::run, this );
+  }
+
+  ~JetExport() { finish(); }
+
+  bool enabled() const { return !target_.empty(); }
+
+  void beginEvent( unsigned long event, double weight ) {
+    if ( !enabled() )
+      return;
+    begin( "JFE1" );
+    put<uint64_t>( event );
+    put<double>( weight );
+    setsPos_ = pending_.size();
+    put<uint16_t>( 0 );
+    nSets_ = 0;
+  }
+
+  // the jets of jetfinder j at radius index r, sorted by pt. with
+  // members the constituents are counted from it, not from the
+  // history of every jet
+  void add( unsigned j, unsigned r, const std::vector<fastjet::PseudoJet>& jets, const JetMembership* members = 0 ) {
+    if ( !enabled() )
+      return;
+    unsigned n = 0;
+    while ( n < jets.size() && jets[n].pt() >= ptMin_ )
+      n++;
+    n = std::min( n, 65535u );
+    put<uint8_t>( j );
+    put<uint16_t>( r );
+    put<uint16_t>( n );
+    for ( unsigned k = 0; k < n; ++k ) {
+      const fastjet::PseudoJet& jet = jets[k];
+      put<float>( jet.pt() );
+      put<float>( jet.eta() );
+      put<float>( jet.phi() );
+      put<float>( jet.m() );
+      put<float>( jet.has_area() ? jet.area() : 0.0 );
+      unsigned real = 0;
+      if ( members )
+        real = members->real( k );
+      else {
+        std::vector<fastjet::PseudoJet> constituents = jet.constituents();
+        for ( unsigned c = 0; c < constituents.size(); ++c )
+          real += !constituents[c].is_pure_ghost();
+      }
+      put<uint16_t>( std::min( real, 65535u ) );
+    }
+    nSets_++;
+  }
+
+  // queue the event, or drop it / wait for space
+  void endEvent() {
+    if ( !enabled() )
+      return;
+    uint16_t sets = nSets_;
+    std::memcpy( &pending_[setsPos_], &sets, sizeof( sets ) );
+    finishFrame();
+    events_++;
+    unsigned long head = head_.load( std::memory_order_relaxed );
+    if ( head - tail_.load( std::memory_order_acquire ) >= slots_.size() ) {
+      if ( !block_ ) {
+        dropped_++;
+        return;
+      }
+      std::chrono::time_point<clock> waitStart = clock::now();
+      while ( head - tail_.load( std::memory_order_acquire ) >= slots_.size() )
+        std::this_thread::sleep_for( std::chrono::microseconds( 50 ) );
+      throttle_ += std::chrono::duration<double>( clock::now() - waitStart ).count();
+    }
+    slots_[head % slots_.size()].swap( pending_ );
+    head_.store( head + 1, std::memory_order_release );
+  }
+
+  // write out what is queued and stop the I/O thread
+  void finish() {
+    if ( !thread_.joinable() )
+      return;
+    stop_ = true;
+    thread_.join();
+    if ( fd_ >= 0 )
+      close( fd_ );
+    fd_ = -1;
+    elapsed_ = std::chrono::duration<double>( clock::now() - start_ ).count();
+  }
+
+  void report() const {
+    if ( !enabled() )
+      return;
+    double mb = bytes_ / ( 1024.0 * 1024.0 );
+    std::cout<<"export: "<<written_<<" of "<<events_<<" events written to "<<target_<<" ( "<<mb<<" MB, "
+             <<( elapsed_ > 0 ? written_ / elapsed_ : 0 )<<" events/s, "<<( elapsed_ > 0 ? mb / elapsed_ : 0 )<<" MB/s ), "
+             <<dropped_.load()<<" dropped, "<<connections_<<" connections, analysis throttled for "<<throttle_<<" s"<<std::endl;
+  }
+
+  void write() const {
+    if ( !enabled() )
+      return;
+    const char* labels[6] = { "events", "written", "dropped", "megabytes", "connections", "throttleseconds" };
+    const double values[6] = { double( events_ ), double( written_ ), double( dropped_.load() ),
+                               bytes_ / ( 1024.0 * 1024.0 ), double( connections_ ), throttle_ };
+    TH1D* h = new TH1D( "exportstats", "Jet Export", 6, -0.5, 5.5 );
+    for ( int i = 0; i < 6; ++i ) {
+      h->GetXaxis()->SetBinLabel( i+1, labels[i] );
+      h->SetBinContent( i+1, values[i] );
+    }
+    h->Write();
+  }
+
+private:
+
+  typedef std::chrono::high_resolution_clock clock;
+
+  template <typename T> void put( T value ) {
+    const char* bytes = reinterpret_cast<const char*>( &value );
+    pending_.insert( pending_.end(), bytes, bytes + sizeof( T ) );
+  }
+
+  void begin( const char* magic ) {
+    pending_.clear();
+    pending_.insert( pending_.end(), magic, magic + 4 );
+    put<uint32_t>( 0 );
+  }
+
+  void finishFrame() {
+    uint32_t size = pending_.size() - 8;
+    std::memcpy( &pending_[4], &size, sizeof( size ) );
+  }
+
+  // I/O thread: connect, then write the queued events in order
+  void run() {
+    while ( true ) {
+      unsigned long tail = tail_.load( std::memory_order_relaxed );
+      bool empty = tail == head_.load( std::memory_order_acquire );
+      if ( empty && stop_ )
+        break;
+      if ( fd_ < 0 && !connect() ) {
+        if ( stop_ ) {
+          // nobody is listening, what is left is lost
+          dropped_ += head_.load( std::memory_order_acquire ) - tail;
+          tail_.store( head_.load( std::memory_order_acquire ), std::memory_order_release );
+          break;
+        }
+        if ( !block_ && !empty ) {
+          dropped_ += head_.load( std::memory_order_acquire ) - tail;
+          tail_.store( head_.load( std::memory_order_acquire ), std::memory_order_release );
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        continue;
+      }
+      if ( empty ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        continue;
+      }
+      const std::vector<char>& record = slots_[tail % slots_.size()];
+      if ( !send( record ) )
+        continue;  // the consumer left, the record goes to the next one
+      bytes_ += record.size();
+      written_++;
+      tail_.store( tail + 1, std::memory_order_release );
+    }
+  }
+
+  bool connect() {
+    int fd = -1;
+    if ( socket_ ) {
+      fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+      struct sockaddr_un address;
+      std::memset( &address, 0, sizeof( address ) );
+      address.sun_family = AF_UNIX;
+      std::strncpy( address.sun_path, path_.c_str(), sizeof( address.sun_path ) - 1 );
+      if ( fd >= 0 && ::connect( fd, (struct sockaddr*) &address, sizeof( address ) ) != 0 ) {
+        close( fd );
+        fd = -1;
+      }
+    }
+    else {
+      // without a reader this fails at once instead of blocking
+      fd = open( path_.c_str(), O_WRONLY | O_NONBLOCK );
+      if ( fd >= 0 )
+        fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) & ~O_NONBLOCK );
+    }
+    if ( fd < 0 )
+      return false;
+    fd_ = fd;
+    connections_++;
+    if ( !send( header_ ) )
+      return false;
+    bytes_ += header_.size();
+    return true;
+  }
+
+  // write all of buffer, closes the connection on failure
+  bool send( const std::vector<char>& buffer ) {
+    std::size_t done = 0;
+    while ( done < buffer.size() ) {
+      ssize_t n = ::write( fd_, &buffer[done], buffer.size() - done );
+      if ( n < 0 && errno == EINTR )
+        continue;
+      if ( n <= 0 ) {
+        std::cerr<<"Warning: export consumer on "<<target_<<" went away, waiting for the next one"<<std::endl;
+        close( fd_ );
+        fd_ = -1;
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  std::string target_;
+  std::string path_;
+  bool socket_;
+  bool block_;
+  double ptMin_;
+
+  // slots [ tail, head ) are queued, the event loop owns head and
+  // the I/O thread owns tail
+  std::vector<std::vector<char> > slots_;
+  std::atomic<unsigned long> head_;
+  std::atomic<unsigned long> tail_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+  int fd_;
+
+  std::vector<char> pending_;
+  std::vector<char> header_;
+  unsigned nSets_;
+  std::size_t setsPos_;
+
+  unsigned long events_;
+  unsigned long written_;
+  std::atomic<unsigned long> dropped_;
+  double bytes_;
+  unsigned connections_;
+  double throttle_;
+  std::chrono::time_point<clock> start_;
+  double elapsed_;
+};
+
+#endif
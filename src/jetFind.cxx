@@ -0,0 +1,245 @@
+// in-process jet finding sweep, the libjetfind API
+// Nick Elsey
+
+#include "jetFind.hh"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/JetDefinition.hh"
+#include "fastjet/AreaDefinition.hh"
+#include "fastjet/ClusterSequenceActiveAreaExplicitGhosts.hh"
+#include "fastjet/Selector.hh"
+
+#include "eventInput.hh"
+
+namespace jetfind {
+
+  const char* algorithmName( Algorithm algorithm ) {
+    static const char* names[nAlgorithms] = { "antikt", "kt", "ca", "sis" };
+    return algorithm >= 0 && algorithm < nAlgorithms ? names[algorithm] : "unknown";
+  }
+
+  // everything kept between events
+  struct Sweep::Workspace {
+    Config config;
+    std::vector<double> radii;
+    // defs[ algorithm * nRadii + radius ] for anti-kt, kt and CA
+    std::vector<fastjet::JetDefinition> defs;
+    fastjet::GhostedAreaSpec ghostSpec;
+    EventInput input;
+    std::unique_ptr<SISConeRunner> sisRunner;
+    std::vector<fastjet::PseudoJet> all, charged, partons;
+    // the clusterings of the current radius, [ 2 * algorithm + charged ]
+    std::unique_ptr<fastjet::ClusterSequenceActiveAreaExplicitGhosts> sequences[2 * nAlgorithms];
+    std::vector<fastjet::PseudoJet> jets[2 * nAlgorithms];
+    std::vector<JetSet> sets;
+    std::vector<bool> chargedRadius;
+    JetCallback jetCallback;
+    RadiusCallback radiusCallback;
+    EventCallback eventCallback;
+    StepCallback beginCallback;
+    StepCallback endCallback;
+    unsigned long nEvents;
+
+    // the ghosts cover the acceptance plus twice the largest radius,
+    // as in the analysis
+    explicit Workspace( const Config& c ) :
+    config( c ), radii( c.sweep.radii() ),
+    ghostSpec( c.maxRap + 2.0 * c.sweep.radii().back(), c.ghostRepeat, c.ghostArea ),
+    input( ghostSpec, c.sweep.radii().front() ), chargedRadius( radii.size(), c.chargedRadii.empty() ), nEvents( 0 ) {
+      const fastjet::JetAlgorithm algorithms[3] = { fastjet::antikt_algorithm, fastjet::kt_algorithm, fastjet::cambridge_algorithm };
+      for ( int a = 0; a < 3; ++a )
+        for ( unsigned i = 0; i < radii.size(); ++i )
+          defs.push_back( fastjet::JetDefinition( algorithms[a], radii[i], config.sweep.scheme() ) );
+      if ( config.algorithms[sis] )
+        sisRunner.reset( new SISConeRunner( radii, config.sis ) );
+      for ( unsigned i = 0; i < c.chargedRadii.size(); ++i )
+        if ( c.chargedRadii[i] < radii.size() )
+          chargedRadius[c.chargedRadii[i]] = true;
+      // the sets of one radius are pointed to, they must not move
+      sets.reserve( 2 * nAlgorithms );
+    }
+
+    void clear() {
+      all.clear();
+      charged.clear();
+      partons.clear();
+    }
+
+    void add( double px, double py, double pz, double e, int charge ) {
+      fastjet::PseudoJet p( px, py, pz, e );
+      if ( std::fabs( p.rap() ) > config.maxRap )
+        return;
+      p.set_user_index( charge );
+      all.push_back( p );
+      if ( charge )
+        charged.push_back( p );
+    }
+
+    bool partonsAccepted() const {
+      if ( !config.partonAcceptance )
+        return true;
+      for ( unsigned i = 0; i < partons.size(); ++i )
+        if ( std::fabs( partons[i].eta() ) > config.maxRap )
+          return false;
+      return true;
+    }
+
+    void notify( const StepCallback& callback, const Step& step ) {
+      if ( callback )
+        callback( step );
+    }
+
+    void run( double weight ) {
+      typedef std::chrono::high_resolution_clock clock;
+      std::chrono::time_point<clock> eventStart = clock::now();
+      Step prepare = { Step::prepare, antikt, 0, false, all.size(), 0 };
+      notify( beginCallback, prepare );
+      input.prepare( all, charged );
+      prepare.time = input.time();
+      notify( endCallback, prepare );
+      if ( sisRunner ) {
+        Step sweep = { Step::sisCone, sis, 0, false, all.size(), 0 };
+        notify( beginCallback, sweep );
+        sisRunner->run( input );
+        sweep.time = sisRunner->eventTime();
+        notify( endCallback, sweep );
+      }
+
+      fastjet::Selector ptMin = fastjet::SelectorPtMin( config.jetPtMin );
+      unsigned nRadii = radii.size();
+      for ( unsigned i = 0; i < nRadii; ++i ) {
+        sets.clear();
+        RadiusSets radius = { nEvents, weight, i, radii[i], { 0 }, { 0 } };
+        for ( int a = 0; a < nAlgorithms; ++a ) {
+          if ( !config.algorithms[a] )
+            continue;
+          bool withCharged = config.charged && chargedRadius[i] && ( a != sis || config.chargedSIS );
+          for ( int c = 0; c < ( withCharged ? 2 : 1 ); ++c ) {
+            bool chargedOnly = c == 1;
+            unsigned slot = 2 * a + c;
+            const fastjet::JetDefinition& def = a == sis ? sisRunner->definition( i ) : defs[a * nRadii + i];
+            const fastjet::ClusterSequenceAreaBase* cs;
+            double time;
+            if ( a == sis && !chargedOnly ) {
+              cs = &sisRunner->sequence( i );
+              time = sisRunner->time( i );
+            }
+            else {
+              Step step = { Step::cluster, Algorithm( a ), i, chargedOnly, 0, 0 };
+              notify( beginCallback, step );
+              std::chrono::time_point<clock> start = clock::now();
+              sequences[slot].reset( input.cluster( def, chargedOnly ) );
+              time = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+              step.inputs = sequences[slot]->n_particles();
+              step.time = time;
+              notify( endCallback, step );
+              cs = sequences[slot].get();
+            }
+            jets[slot] = fastjet::sorted_by_pt( ptMin( cs->inclusive_jets() ) );
+            JetSet set = { nEvents, weight, Algorithm( a ), i, radii[i], chargedOnly, def, *cs, jets[slot], time };
+            sets.push_back( set );
+            ( chargedOnly ? radius.charged : radius.full )[a] = &sets.back();
+            if ( jetCallback )
+              jetCallback( sets.back() );
+          }
+        }
+        if ( radiusCallback )
+          radiusCallback( radius );
+      }
+
+      if ( eventCallback ) {
+        EventSummary summary = { nEvents, weight, all, charged, partons,
+                                 std::chrono::duration<double, std::milli>( clock::now() - eventStart ).count() };
+        eventCallback( summary );
+      }
+      nEvents++;
+    }
+  };
+
+  Sweep::Sweep( const Config& config ) : work_( new Workspace( config ) ) { }
+
+  Sweep::~Sweep() { }
+
+  void Sweep::onJets( const JetCallback& callback ) { work_->jetCallback = callback; }
+
+  void Sweep::onRadius( const RadiusCallback& callback ) { work_->radiusCallback = callback; }
+
+  void Sweep::onEvent( const EventCallback& callback ) { work_->eventCallback = callback; }
+
+  void Sweep::onBegin( const StepCallback& callback ) { work_->beginCallback = callback; }
+
+  void Sweep::onEnd( const StepCallback& callback ) { work_->endCallback = callback; }
+
+  bool Sweep::process( ParticleSpan particles, double weight, ParticleSpan partons ) {
+    if ( !load( particles, partons ) )
+      return false;
+    cluster( weight );
+    return true;
+  }
+
+  bool Sweep::process( const std::vector<fastjet::PseudoJet>& particles, double weight,
+                       const std::vector<fastjet::PseudoJet>& partons ) {
+    if ( !load( particles, partons ) )
+      return false;
+    cluster( weight );
+    return true;
+  }
+
+  bool Sweep::load( ParticleSpan particles, ParticleSpan partons ) {
+    Workspace& w = *work_;
+    w.clear();
+    for ( std::size_t i = 0; i < partons.size; ++i ) {
+      const Particle& p = partons.data[i];
+      w.partons.push_back( fastjet::PseudoJet( p.px, p.py, p.pz, p.e ) );
+      w.partons.back().set_user_index( p.charge );
+    }
+    if ( !w.partonsAccepted() ) {
+      w.clear();
+      return false;
+    }
+    for ( std::size_t i = 0; i < particles.size; ++i ) {
+      const Particle& p = particles.data[i];
+      w.add( p.px, p.py, p.pz, p.e, p.charge );
+    }
+    return true;
+  }
+
+  bool Sweep::load( const std::vector<fastjet::PseudoJet>& particles, const std::vector<fastjet::PseudoJet>& partons ) {
+    Workspace& w = *work_;
+    w.clear();
+    w.partons = partons;
+    if ( !w.partonsAccepted() ) {
+      w.clear();
+      return false;
+    }
+    for ( unsigned i = 0; i < particles.size(); ++i ) {
+      const fastjet::PseudoJet& p = particles[i];
+      if ( std::fabs( p.rap() ) > w.config.maxRap )
+        continue;
+      w.all.push_back( p );
+      if ( p.user_index() )
+        w.charged.push_back( p );
+    }
+    return true;
+  }
+
+  void Sweep::cluster( double weight ) { work_->run( weight ); }
+
+  const std::vector<fastjet::PseudoJet>& Sweep::particles() const { return work_->all; }
+
+  const std::vector<fastjet::PseudoJet>& Sweep::charged() const { return work_->charged; }
+
+  const std::vector<fastjet::PseudoJet>& Sweep::partons() const { return work_->partons; }
+
+  const std::vector<double>& Sweep::radii() const { return work_->radii; }
+
+  unsigned long Sweep::events() const { return work_->nEvents; }
+
+  const fastjet::GhostedAreaSpec& Sweep::ghostSpec() const { return work_->ghostSpec; }
+
+  const SISConeRunner* Sweep::sisCone() const { return work_->sisRunner.get(); }
+
+}
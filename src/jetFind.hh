@@ -0,0 +1,198 @@
+// in-process jet finding sweep, the libjetfind API
+// Nick Elsey
+
+// jetfind::Sweep is the clustering sweep of jetFindAnalysis, which
+// drives it through the callbacks below, and of any event loop
+// that lives elsewhere ( make lib builds lib/libjetfind.a, it
+// needs FastJet but not ROOT or Pythia ):
+//
+//   jetfind::Config config;              // default radii 0.1 - 1.0
+//   config.sweep.read( "sweep.txt" );    // optional, see sweepConfig.hh
+//   jetfind::Sweep sweep( config );
+//   sweep.onJets( []( const jetfind::JetSet& set ) { ... } );
+//   for each event:
+//     sweep.process( jetfind::ParticleSpan( particles, n ), weight );
+//
+// - particles are read in place from the caller's array, only the
+//   ones inside the acceptance are converted to PseudoJets, into
+//   buffers that are kept across events. the ghosts and the cell
+//   ordering are made once per event and shared by every
+//   clustering, as in the analysis ( see eventInput.hh )
+// - the onJets callback gets every jetfinder and radius in turn,
+//   with the jets above jetPtMin and their cluster sequence, so
+//   areas and constituents are available. both are only valid
+//   during the callback; copy what has to be kept. the JetGroomer
+//   helper takes exactly these arguments, JetShapes and JetEEC a
+//   JetMembership built from them
+// - the onRadius callback follows once every jetfinder of a radius
+//   has run, with all of their JetSets, for analyses that compare
+//   jetfinders. they stay valid until the next radius
+// - the onEvent callback follows once all clusterings of the
+//   event are done
+// - onBegin / onEnd bracket every stage of the event: preparing
+//   the input, the SISCone sweep and each clustering, for timing,
+//   hardware counters or the equivalence check
+// SISCone runs all radii before the first callback, on
+// config.sis.n_threads threads. process() is load() followed by
+// cluster(); between the two the converted particles can be read
+// back, e.g. to reject the event before it is clustered
+
+#ifndef JETFIND_HH
+#define JETFIND_HH
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstddef>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequenceAreaBase.hh"
+#include "fastjet/JetDefinition.hh"
+#include "fastjet/AreaDefinition.hh"
+
+#include "sweepConfig.hh"
+#include "sisConeRunner.hh"
+
+namespace jetfind {
+
+  enum Algorithm { antikt = 0, kt, ca, sis, nAlgorithms };
+
+  // "antikt", "kt", "ca" or "sis", as in the histogram names
+  const char* algorithmName( Algorithm algorithm );
+
+  // a final state particle as the caller stores it
+  struct Particle {
+    double px, py, pz, e;
+    int charge;         // 0 for neutral particles
+  };
+
+  // a view of the caller's particles, nothing is copied
+  struct ParticleSpan {
+    const Particle* data;
+    std::size_t size;
+    ParticleSpan() : data( 0 ), size( 0 ) { }
+    ParticleSpan( const Particle* d, std::size_t n ) : data( d ), size( n ) { }
+    ParticleSpan( const std::vector<Particle>& v ) : data( v.empty() ? 0 : &v[0] ), size( v.size() ) { }
+  };
+
+  struct Config {
+    SweepConfig sweep;            // radii and recombination scheme
+    bool algorithms[nAlgorithms]; // which jetfinders run ( default all )
+    double maxRap;                // particle acceptance in rapidity ( default 1.0 )
+    double jetPtMin;              // jets below are not passed on ( default 1.0 )
+    bool charged;                 // also cluster the charged particles ( default false )
+    std::vector<unsigned> chargedRadii; // radius indices of the charged clusterings ( default all )
+    bool chargedSIS;              // SISCone on the charged particles too ( default true )
+    bool partonAcceptance;        // skip events with a parton outside maxRap in eta ( default false )
+    double ghostArea;             // ( default 0.01 )
+    int ghostRepeat;              // ( default 1 )
+    SISConeSettings sis;
+    Config() : maxRap( 1.0 ), jetPtMin( 1.0 ), charged( false ), chargedSIS( true ), partonAcceptance( false ),
+               ghostArea( 0.01 ), ghostRepeat( 1 ) {
+      for ( int i = 0; i < nAlgorithms; ++i )
+        algorithms[i] = true;
+    }
+  };
+
+  // the jets of one jetfinder and radius in one event
+  struct JetSet {
+    unsigned long event;                             // events processed before this one
+    double weight;
+    Algorithm algorithm;
+    unsigned radiusIndex;
+    double radius;
+    bool charged;                                    // charged particles only
+    const fastjet::JetDefinition& definition;
+    const fastjet::ClusterSequenceAreaBase& sequence;
+    const std::vector<fastjet::PseudoJet>& jets;    // above jetPtMin, by decreasing pt
+    double time;                                     // clustering time in ms
+  };
+
+  // every jetfinder at one radius in one event, null where it
+  // did not run
+  struct RadiusSets {
+    unsigned long event;
+    double weight;
+    unsigned radiusIndex;
+    double radius;
+    const JetSet* full[nAlgorithms];
+    const JetSet* charged[nAlgorithms];
+  };
+
+  // a stage of the event processing
+  struct Step {
+    enum Kind { prepare, sisCone, cluster };
+    Kind kind;
+    Algorithm algorithm;      // cluster only, the full SISCone jets come from the sisCone step
+    unsigned radiusIndex;     // cluster only
+    bool charged;             // cluster only
+    std::size_t inputs;       // particles, and ghosts for cluster, in onEnd
+    double time;              // in ms, in onEnd
+  };
+
+  // the converted inputs of one event, after all clusterings
+  struct EventSummary {
+    unsigned long event;
+    double weight;
+    const std::vector<fastjet::PseudoJet>& particles;  // inside the acceptance, user index = charge
+    const std::vector<fastjet::PseudoJet>& charged;
+    const std::vector<fastjet::PseudoJet>& partons;
+    double time;                                        // total processing time in ms
+  };
+
+  typedef std::function<void( const JetSet& )> JetCallback;
+  typedef std::function<void( const RadiusSets& )> RadiusCallback;
+  typedef std::function<void( const EventSummary& )> EventCallback;
+  typedef std::function<void( const Step& )> StepCallback;
+
+  class Sweep {
+  public:
+
+    explicit Sweep( const Config& config );
+    ~Sweep();
+
+    void onJets( const JetCallback& callback );
+    void onRadius( const RadiusCallback& callback );
+    void onEvent( const EventCallback& callback );
+    void onBegin( const StepCallback& callback );
+    void onEnd( const StepCallback& callback );
+
+    // cluster one event with every jetfinder and radius. partons
+    // are optional and passed on to onEvent unchanged. returns
+    // false, without clustering, if the partons fail
+    // config.partonAcceptance
+    bool process( ParticleSpan particles, double weight = 1.0, ParticleSpan partons = ParticleSpan() );
+
+    // the same for particles that are already PseudoJets with the
+    // charge as user index, e.g. from the HepMC or toy sources
+    bool process( const std::vector<fastjet::PseudoJet>& particles, double weight = 1.0,
+                  const std::vector<fastjet::PseudoJet>& partons = std::vector<fastjet::PseudoJet>() );
+
+    // the two halves of process: convert the event, then cluster it
+    bool load( ParticleSpan particles, ParticleSpan partons = ParticleSpan() );
+    bool load( const std::vector<fastjet::PseudoJet>& particles,
+               const std::vector<fastjet::PseudoJet>& partons = std::vector<fastjet::PseudoJet>() );
+    void cluster( double weight = 1.0 );
+
+    // the loaded event, inside the acceptance with the charge as
+    // user index
+    const std::vector<fastjet::PseudoJet>& particles() const;
+    const std::vector<fastjet::PseudoJet>& charged() const;
+    const std::vector<fastjet::PseudoJet>& partons() const;
+
+    const std::vector<double>& radii() const;
+    unsigned long events() const;
+    const fastjet::GhostedAreaSpec& ghostSpec() const;
+    // null unless SISCone runs
+    const SISConeRunner* sisCone() const;
+
+  private:
+
+    struct Workspace;
+    std::unique_ptr<Workspace> work_;
+  };
+
+}
+
+#endif
@@ -36,6 +36,7 @@
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <memory>
 #include <random>
 #include <time.h>
 #include <limits.h>
@@ -64,6 +65,34 @@
 // Pythia generator
 #include "Pythia8/Pythia.h"
 
+// analysis helpers
+#include "analysisOptions.hh"
+#include "jetFind.hh"
+#include "sisConeRunner.hh"
+#include "jetMatching.hh"
+#include "histSnapshot.hh"
+#include "jetEEC.hh"
+#include "jetShapes.hh"
+#include "jetMembership.hh"
+#include "jetGroomer.hh"
+#include "jetMatchStudy.hh"
+#include "sweepConfig.hh"
+#include "histStorage.hh"
+#include "eventTrigger.hh"
+#include "fastLeadJet.hh"
+#include "perfCounters.hh"
+#include "workQueue.hh"
+#include "clusterEquivalence.hh"
+#include "pythiaStartup.hh"
+#include "jetExport.hh"
+#include "telemetry.hh"
+#include "sequentialStop.hh"
+#include "ptHatWeights.hh"
+#include "toyEventGenerator.hh"
+#include "hepmcReader.hh"
+#include "mpiReduce.hh"
+#include "clusterScaling.hh"
+
 // the grid does not have std::to_string() for some ungodly reason
 // replacing it here. Simply ostringstream
 namespace patch {
@@ -75,13 +104,14 @@ namespace patch {
   }
 }
 
-// used to convert pythia events to vectors of pseudojets
-int convertToPseudoJet( Pythia8::Pythia& p, double max_rap, std::vector<fastjet::PseudoJet>& all, std::vector<fastjet::PseudoJet>& charged, std::vector<fastjet::PseudoJet>& part ) {
+// used to read pythia events into the particles the sweep
+// converts ( see jetFind.hh ): the visible final state, with the
+// charge, and the two outgoing partons, with 3 x their charge
+void readPythiaEvent( Pythia8::Pythia& p, std::vector<jetfind::Particle>& particles, std::vector<jetfind::Particle>& partons ) {
   
   // clear the event containers
-  all.clear();
-  charged.clear();
-  part.clear();
+  particles.clear();
+  partons.clear();
   
   // get partons first
   // the initial protons are ids 1 & 2,
@@ -90,48 +120,111 @@ int convertToPseudoJet( Pythia8::Pythia& p, double max_rap, std::vector<fastjet:
     std::cerr<<"Error: assumption that id 5 is the outgoing parton is not valid."<<std::endl;
   if (p.event[6].status() != -23)
     std::cerr<<"Error: assumption that id 6 is the outgoing parton is not valid."<<std::endl;
-  fastjet::PseudoJet part1( p.event[5].px(), p.event[5].py(), p.event[5].pz(), p.event[5].e() );
-  part1.set_user_index( 3 * p.event[5].charge() );
-  fastjet::PseudoJet part2( p.event[6].px(), p.event[6].py(), p.event[6].pz(), p.event[6].e() );
-  part2.set_user_index( 3 * p.event[6].charge() );
-  if ( fabs(part1.eta()) > max_rap || fabs(part2.eta()) >max_rap )
-    return 0;
-  part.push_back( part1 );
-  part.push_back( part2 );
+  for ( int i = 5; i <= 6; ++i ) {
+    jetfind::Particle part = { p.event[i].px(), p.event[i].py(), p.event[i].pz(), p.event[i].e(), int( 3 * p.event[i].charge() ) };
+    partons.push_back( part );
+  }
   
-  // now loop over all particles, and fill the vectors
+  // now loop over all particles, and fill the vector
   for ( int i = 0; i < p.event.size(); ++i ) {
     if ( p.event[i].isFinal() && p.event[i].isVisible() ) {
-      fastjet::PseudoJet tmp( p.event[i].px(), p.event[i].py(), p.event[i].pz(), p.event[i].e() );
-      tmp.set_user_index( p.event[i].charge() );
-      
-      // check to make sure its in our rapidity range
-      if ( fabs( tmp.rap() ) > max_rap  )
-        continue;
-      
-      all.push_back( tmp );
-      if ( p.event[i].charge() )
-        charged.push_back( tmp );
-      
+      jetfind::Particle tmp = { p.event[i].px(), p.event[i].py(), p.event[i].pz(), p.event[i].e(), int( p.event[i].charge() ) };
+      particles.push_back( tmp );
     }
   }
-  
-  return 1;
 }
 
 // Arguments
 // 0: xml directory for pythia
 // 1: exponent base 10 for number of events
 // 2: output location
+// 3+: optional key=value settings
+//     sweep_file   : radii and recombination scheme of the sweep ( default 0.1 to 1.0 in
+//                    steps of 0.1, see sweepConfig.hh )
+//     hist_precision : double or float for the per radius histograms ( default double,
+//                      see histStorage.hh )
+//     sis_threads  : workers for the SISCone radius sweep ( default 1 )
+//     sis_overlap  : SISCone split-merge overlap threshold ( default 0.75 )
+//     sis_npass    : max number of stable cone passes, 0 = no limit ( default 0 )
+//     sis_ptmin    : protojet pt cut before split-merge ( default 0 )
+//     sis_smscale  : split-merge stopping scale, 0 = no cap ( default 0 )
+//     telemetry_file     : JSON-lines progress records ( default <output>.telemetry, "none" to disable )
+//     telemetry_interval : seconds between records ( default 10 )
+//     progress_interval  : seconds between progress lines on stdout ( default 60, -1 to disable )
+//     stop_targets   : comma separated observables for sequential stopping, e.g. deltaE,npartlead
+//                      when given, 10^exponent becomes the hard event cap
+//     stop_precision : relative precision on the mean of each target and radius ( default 0.01 )
+//     stop_interval  : events between precision checks ( default 100 )
+//     gen_mode       : unbiased, bias or bins ( default unbiased, see ptHatWeights.hh )
+//     gen_pthatmin   : pT-hat threshold for unbiased and bias modes ( default 200 )
+//     gen_pthatbins  : comma separated pT-hat bin edges for bins mode, -1 = open ( default 200,300,450,700,1000,-1 )
+//     gen_biaspow    : power of pT-hat for bias2Selection ( default 4 )
+//     event_source   : pythia, toy or hepmc ( default pythia, see toyEventGenerator.hh, hepmcReader.hh )
+//     toy_mult       : mean background multiplicity ( default 1000 )
+//     toy_fixedmult  : 1 for a fixed instead of poisson multiplicity ( default 0 )
+//     toy_temp       : background pt slope in GeV ( default 0.5 )
+//     toy_jetpt      : pt of each embedded hard jet ( default 200 )
+//     toy_jetpart    : fragments per hard jet ( default 20 )
+//     toy_jetwidth   : angular spread of the fragments ( default 0.1 )
+//     hepmc_file     : HepMC3 ascii input for event_source=hepmc, may be .gz or .zst
+//     hepmc_partonstatus : status of the two outgoing hard partons ( default 23 )
+//     seed           : random seed for pythia and toy events, 0 = from the clock ( default 0 )
+//     snapshot_file     : memory-mapped file for live histogram snapshots, e.g. /dev/shm/jetfind
+//                         ( default none, read with generate_output live, see histSnapshot.hh )
+//     snapshot_interval : seconds between snapshots ( default 30 )
+//     eec_maxn       : highest leading jet energy correlator, 2 = EEC, 3 = EEC and projected E3C,
+//                      0 = none ( default 3, see jetEEC.hh )
+//     sd_zcut, sd_beta     : soft drop parameters of the leading jets ( default 0.1, 0 )
+//     trim_rsub, trim_fcut : trimming subjet radius and pt fraction ( default 0.2, 0.05 )
+//     filt_rsub, filt_nsub : filtering subjet radius and number kept ( default 0.3, 3 )
+//     trig_leadpt    : minimum leading particle pt before clustering, 0 = off ( default 0 )
+//     trig_windowpt  : minimum summed pt in a rapidity - phi window, 0 = off ( default 0 )
+//     trig_window    : size of that window ( default 1.0, see eventTrigger.hh )
+//     fastlead       : approximate leading jets from a seeded cone, none, cone or grid
+//                      ( default none, see fastLeadJet.hh )
+//     fastlead_validate : fraction of the events that are also fully clustered, to
+//                         validate the approximate jets against anti-kt ( default 0.1 ).
+//                         all other histograms are filled from those events only
+//     perf_counters  : 1 to read cycles, instructions, cache and branch misses around
+//                      every stage of the event loop ( default 0, see perfCounters.hh )
+//     work_dir       : directory shared by workers that pull blocks of the 10^exponent
+//                      events from it ( default none, see workQueue.hh )
+//     work_blocksize : events per block ( default 1000 )
+//     work_timeout   : seconds without a heartbeat before a block is handed out again ( default 600 )
+//     equiv_check    : fraction of the events also clustered with the plain
+//                      ClusterSequenceArea path and compared jet by jet, 0 = off
+//                      ( default 0, see clusterEquivalence.hh )
+//     equiv_tol      : pt ( relative ), eta and phi tolerance of that comparison ( default 1e-6 )
+//     equiv_areatol  : jet area tolerance of that comparison ( default 1e-6 )
+//     pythia_cache   : path prefix of a cache of the parsed pythia settings and particle
+//                      data, made by the first job and read by later ones ( default
+//                      none, see pythiaStartup.hh )
+//     export_target  : named pipe, or unix:<path> for a unix socket, that receives the
+//                      jets of every event while the job runs ( default none, see
+//                      jetExport.hh )
+//     export_policy  : drop or block, what to do when the consumer falls behind ( default drop )
+//     export_queue   : events queued for the consumer ( default 256 )
+//     export_ptmin   : minimum pt of the exported jets ( default 1 )
+//     match_ptmin    : minimum pt of the jets matched to the partons, across jetfinders
+//                      and across radii ( default 10, see jetMatchStudy.hh )
+//
+// built with -DJETFIND_MPI ( make mpi ) each rank generates its own
+// slice of the 10^exponent events with seed + rank ( seed 0 becomes 1,
+// so runs are reproducible ), and the histograms are reduced onto
+// rank 0, which writes the output file:
+//   mpirun -np 4 ./bin/jetFindAnalysis_mpi xmldir 3 out/mpi.root
 
 
 int main( int argc, const char** argv ) {
   
-  // Histograms will calculate gaussian errors
-  // -----------------------------------------
-  TH1::SetDefaultSumw2( );
-  TH2::SetDefaultSumw2( );
-  TH3::SetDefaultSumw2( );
+  // MPI setup, a single rank otherwise
+  int mpiRank = 0;
+  int mpiSize = 1;
+#ifdef JETFIND_MPI
+  MPI_Init( NULL, NULL );
+  MPI_Comm_rank( MPI_COMM_WORLD, &mpiRank );
+  MPI_Comm_size( MPI_COMM_WORLD, &mpiSize );
+#endif
   
   typedef std::chrono::high_resolution_clock clock;
   
@@ -142,6 +235,7 @@ int main( int argc, const char** argv ) {
   unsigned exponent;
   std::string outFile;
   std::string xmldir;
+  AnalysisOptions options;
 
   switch ( argc ) {
     case 1: {
@@ -151,40 +245,92 @@ int main( int argc, const char** argv ) {
       xmldir = "/wsu/home/dx/dx54/dx5412/software/pythia8219/share/Pythia8/xmldoc";
       break;
     }
-    case 4: {
+    default: {
+      if ( argc < 4 ) {
+        std::cerr<<"Error: unexpected number of inputs."<<std::endl;
+        return -1;
+      }
       xmldir = argv[1];
       exponent = atoi( argv[2] );
       outFile = argv[3];
+      if ( !options.parse( argc, argv, 4 ) )
+        return -1;
       break;
     }
-    default: {
-      std::cerr<<"Error: unexpected number of inputs."<<std::endl;
-      return -1;
-    }
   }
+  options.print( std::cout );
   
   // set the total number of events as
   // 10^exponent
   unsigned maxEvent = pow( 10, exponent );
+  
+  // with MPI, each rank takes its share of the events
+  // and a seed offset by its rank
+  unsigned seed = options.get( "seed", 0u );
+  if ( mpiSize > 1 ) {
+    maxEvent = maxEvent / mpiSize + ( (unsigned) mpiRank < maxEvent % mpiSize ? 1 : 0 );
+    seed = ( seed ? seed : 1 ) + mpiRank;
+    std::cout<<"rank "<<mpiRank<<" of "<<mpiSize<<", seed "<<seed<<": ";
+  }
   std::cout<<"set for "<<maxEvent<<" events"<<std::endl;
   
+  // events come from pythia, or from the toy generator
+  std::string eventSource = options.get( "event_source", "pythia" );
+  bool useToy = eventSource == "toy";
+  bool useHepMC = eventSource == "hepmc";
+  bool usePythia = eventSource == "pythia";
+  if ( !usePythia && !useToy && !useHepMC ) {
+    std::cerr<<"Error: unknown event_source "<<eventSource<<std::endl;
+    return -1;
+  }
+  
   // setup pythia
   // ------------
   
-  // create the pythia generator and initialize it with the xmldoc in my pythia8 directory
-  //Pythia8::Pythia pythia( xmldir );
-  Pythia8::Pythia pythia;
+  // create the pythia generator from the xml directory, or from
+  // the settings cache ( see pythiaStartup.hh ). other event
+  // sources do not need pythia at all
+  PythiaStartup startup( xmldir, options.get( "pythia_cache", "" ), analysis_start );
+  std::unique_ptr<Pythia8::Pythia> pythia( usePythia ? startup.create() : 0 );
   
   // settings for LHC pp at 13 TeV
-  pythia.readString("Beams:eCM = 13000");
-  pythia.readString("HardQCD:all = on");
-  pythia.readString("Random:setSeed = on");
-  pythia.readString("Random:seed = 0");
-  pythia.readString("PhaseSpace:pTHatMin = 200.0");
-  
-  // initialize the pythia generator
-  pythia.init();
-  pythia.next();
+  if ( usePythia ) {
+    pythia->readString("Beams:eCM = 13000");
+    pythia->readString("HardQCD:all = on");
+    pythia->readString("Random:setSeed = on");
+    pythia->readString("Random:seed = " + patch::to_string( seed ));
+  }
+  
+  // pT-hat range and event weights depend on the generation mode
+  // only pythia events are generated here
+  std::string genMode = options.get( "gen_mode", "unbiased" );
+  if ( !usePythia && genMode != "unbiased" ) {
+    std::cerr<<"Warning: gen_mode only applies to pythia events"<<std::endl;
+    genMode = "unbiased";
+  }
+  PtHatWeights weights( genMode, options.get( "gen_pthatmin", 200.0 ),
+                        options.get( "gen_pthatbins", "200,300,450,700,1000,-1" ), options.get( "gen_biaspow", 4.0 ) );
+  
+  // Histograms will calculate gaussian errors
+  // -----------------------------------------
+  // with unit weights the errors follow from the bin contents,
+  // only weighted events need the sum of squared weights. the
+  // fastlead sample is weighted by 1 / fastlead_validate
+  std::string fastLeadMode = options.get( "fastlead", "none" );
+  double fastLeadFraction = options.get( "fastlead_validate", 0.1 );
+  if ( weights.weighted() || useHepMC || fastLeadMode != "none" ) {
+    TH1::SetDefaultSumw2( );
+    TH2::SetDefaultSumw2( );
+    TH3::SetDefaultSumw2( );
+  }
+  
+  // initialize the pythia generator, the first event is the
+  // first one of the loop
+  if ( usePythia ) {
+    startup.initStart();
+    weights.initBin( *pythia, 0 );
+    startup.initDone();
+  }
   // set jet finding parameters
   // --------------------------
 
@@ -192,6 +338,23 @@ int main( int argc, const char** argv ) {
   const double max_track_rap = 4.0;
   const double max_rap = max_track_rap;
   
+  // toy events, for multiplicity scaling studies
+  ToySettings toySettings;
+  toySettings.multiplicity = options.get( "toy_mult", 1000.0 );
+  toySettings.poisson = !options.get( "toy_fixedmult", 0 );
+  toySettings.temperature = options.get( "toy_temp", 0.5 );
+  toySettings.yMax = max_track_rap;
+  toySettings.jetPt = options.get( "toy_jetpt", 200.0 );
+  toySettings.jetParticles = options.get( "toy_jetpart", 20u );
+  toySettings.jetWidth = options.get( "toy_jetwidth", 0.1 );
+  toySettings.seed = seed;
+  ToyEventGenerator toy( toySettings );
+  
+  // or events read from a HepMC3 file, parsed on a separate thread
+  HepMCReader hepmc( options.get( "hepmc_file", "" ), max_track_rap, options.get( "hepmc_partonstatus", 23 ) );
+  if ( useHepMC && !hepmc.open() )
+    return -1;
+  
   // first some base jetfinding definitions
   double baseRadius = 0.8;
   fastjet::JetDefinition antiKtBase( fastjet::antikt_algorithm, baseRadius );
@@ -199,27 +362,29 @@ int main( int argc, const char** argv ) {
   fastjet::JetDefinition CaBase( fastjet::cambridge_algorithm, baseRadius );
 
   // but we will also be testing these with different radii, so we'll initialize that here
-  // there will be nRadii different radii, in increments of deltaRad;
-  const int nRadii = 10;
-  double deltaRad = 0.1;
-  double overlap_threshold = 0.75;
-  double radii[nRadii];
-  fastjet::JetDefinition antiKtDefs[nRadii];
-  fastjet::JetDefinition KtDefs[nRadii];
-  fastjet::JetDefinition CaDefs[nRadii];
-  fastjet::JetDefinition SISDefs[nRadii];
-  
-  for ( int i = 0; i < nRadii; ++i ) {
-    radii[i] = deltaRad * (i+1);
-
-    antiKtDefs[i] = fastjet::JetDefinition( fastjet::antikt_algorithm, radii[i] );
-    KtDefs[i] = fastjet::JetDefinition( fastjet::kt_algorithm, radii[i] );
-    CaDefs[i] = fastjet::JetDefinition( fastjet::cambridge_algorithm, radii[i] );
-
-    // and for SISCone
-    fastjet::JetDefinition::Plugin * plugin = new fastjet::SISConePlugin(radii[i], overlap_threshold);
-    SISDefs[i] = fastjet::JetDefinition(plugin);
-  }
+  // there will be nRadii different radii, 0.1 to 1.0 unless a
+  // sweep file gives them ( see sweepConfig.hh )
+  SweepConfig sweep;
+  std::string sweepFile = options.get( "sweep_file", "" );
+  if ( !sweepFile.empty() && !sweep.read( sweepFile ) )
+    return -1;
+  const int nRadii = sweep.size();
+  // the base radius may be one of them, charged jets are found there
+  const int baseRadiusIdx = sweep.index( baseRadius );
+  if ( baseRadiusIdx < 0 )
+    std::cerr<<"Warning: the sweep does not contain the base radius "<<baseRadius<<", no charged jets"<<std::endl;
+  std::vector<double> radii = sweep.radii();
+  if ( mpiRank == 0 )
+    std::cout<<"sweep: "<<nRadii<<" radii from "<<radii.front()<<" to "<<radii.back()<<", "<<sweep.schemeName()<<std::endl;
+  
+  // SISCone has its own runner, which owns the plugins and
+  // clusters all radii at once ( see sisConeRunner.hh )
+  SISConeSettings sisSettings;
+  sisSettings.overlap_threshold = options.get( "sis_overlap", 0.75 );
+  sisSettings.n_threads = options.get( "sis_threads", 1u );
+  sisSettings.n_pass_max = options.get( "sis_npass", 0 );
+  sisSettings.protojet_ptmin = options.get( "sis_ptmin", 0.0 );
+  sisSettings.split_merge_stopping_scale = options.get( "sis_smscale", 0.0 );
 
   // set up our fastjet environment
   // ------------------------------
@@ -227,36 +392,125 @@ int main( int argc, const char** argv ) {
   // We'll be using fastjet:PseudoJet for all our work
   // so we'll make a few helpers
   
-  // this will include all final state particles
-  // ( minus neutrinos )
-  std::vector<fastjet::PseudoJet> allFinal;
-  
-  // this will include all charged particles in the final state
-  std::vector<fastjet::PseudoJet> chargedFinal;
-  
-  // this will be the two partons from the scattering
-  std::vector<fastjet::PseudoJet> partons;
-  
-  
+  // the events as the sources give them: pythia's particles
+  // and partons, or PseudoJets from the toy and HepMC sources
+  std::vector<jetfind::Particle> pythiaParticles;
+  std::vector<jetfind::Particle> pythiaPartons;
+  std::vector<fastjet::PseudoJet> sourceParticles;
+  std::vector<fastjet::PseudoJet> sourceCharged;
+  std::vector<fastjet::PseudoJet> sourcePartons;
   
   // create an area definition for the clustering
   //----------------------------------------------------------
   // ghosts should go up to the acceptance of the detector or
   // (with infinite acceptance) at least 2R beyond the region
-  // where you plan to investigate jets.
+  // where you plan to investigate jets. the sweep sets
+  // ghost_max_rap to max_rap + 2 * the largest radius
   const int ghost_repeat = 1;
   const double ghost_area = 0.01;
-  // we'll set ghost_max_rap to the largest applicable based
-  // on our radius settings
-  const double ghost_max_rap = max_rap + 2.0 * radii[nRadii];
   
-  fastjet::GhostedAreaSpec area_spec = fastjet::GhostedAreaSpec( ghost_max_rap, ghost_repeat, ghost_area );
+  // the clustering sweep ( see jetFind.hh ). every clustering of
+  // an event shares its ghosts and cell-ordered particles ( see
+  // eventInput.hh ), and the charged particles are clustered at
+  // the base radius only, without SISCone
+  jetfind::Config jetConfig;
+  jetConfig.sweep = sweep;
+  jetConfig.maxRap = max_track_rap;
+  jetConfig.jetPtMin = 1.0;
+  jetConfig.charged = baseRadiusIdx >= 0;
+  if ( baseRadiusIdx >= 0 )
+    jetConfig.chargedRadii.push_back( baseRadiusIdx );
+  jetConfig.chargedSIS = false;
+  jetConfig.partonAcceptance = true;
+  jetConfig.ghostArea = ghost_area;
+  jetConfig.ghostRepeat = ghost_repeat;
+  jetConfig.sis = sisSettings;
+  jetfind::Sweep jetFinder( jetConfig );
+  const SISConeRunner& sisRunner = *jetFinder.sisCone();
+  
+  fastjet::GhostedAreaSpec area_spec = jetFinder.ghostSpec();
   fastjet::AreaDefinition  area_def = fastjet::AreaDefinition(fastjet::active_area_explicit_ghosts, area_spec);
   
+  // this will include all final state particles
+  // ( minus neutrinos ) inside the acceptance
+  const std::vector<fastjet::PseudoJet>& allFinal = jetFinder.particles();
+  
+  // this will include all charged particles in the final state
+  const std::vector<fastjet::PseudoJet>& chargedFinal = jetFinder.charged();
+  
+  // this will be the two partons from the scattering
+  const std::vector<fastjet::PseudoJet>& partons = jetFinder.partons();
+  
+  // progress and resource monitoring, written by a separate thread
+  const char* algorithmNames[] = { "antikt", "kt", "ca", "sis" };
+  Telemetry telemetry( std::vector<std::string>( algorithmNames, algorithmNames + 4 ), maxEvent );
+  std::string telemetryFile = options.get( "telemetry_file", ( outFile.substr( 0, outFile.rfind( ".root" ) ) + ".telemetry" ).c_str() );
+  if ( mpiSize > 1 && !telemetryFile.empty() )
+    telemetryFile += "_" + patch::to_string( mpiRank );
+  if ( telemetryFile == "none" )
+    telemetryFile.clear();
+  double telemetryInterval = options.get( "telemetry_interval", 10.0 );
+  double progressInterval = options.get( "progress_interval", 60.0 );
+  std::string stopTargets = options.get( "stop_targets", "" );
+  double stopPrecision = options.get( "stop_precision", 0.01 );
+  unsigned stopInterval = options.get( "stop_interval", 100u );
+  if ( weights.mode() == PtHatWeights::bins && !stopTargets.empty() ) {
+    std::cerr<<"Warning: sequential stopping is not available with gen_mode=bins, ignoring stop_targets"<<std::endl;
+    stopTargets.clear();
+  }
+  std::string snapshotFile = options.get( "snapshot_file", "" );
+  if ( mpiSize > 1 && !snapshotFile.empty() )
+    snapshotFile += "_" + patch::to_string( mpiRank );
+  double snapshotInterval = options.get( "snapshot_interval", 30.0 );
+  int eecMaxN = options.get( "eec_maxn", 3 );
+  GroomSettings groomSettings;
+  groomSettings.zcut = options.get( "sd_zcut", 0.1 );
+  groomSettings.beta = options.get( "sd_beta", 0.0 );
+  groomSettings.trimRadius = options.get( "trim_rsub", 0.2 );
+  groomSettings.trimFraction = options.get( "trim_fcut", 0.05 );
+  groomSettings.filterRadius = options.get( "filt_rsub", 0.3 );
+  groomSettings.filterN = options.get( "filt_nsub", 3u );
+  double matchPtMin = options.get( "match_ptmin", 10.0 );
+  TriggerSettings triggerSettings;
+  triggerSettings.leadPt = options.get( "trig_leadpt", 0.0 );
+  triggerSettings.windowPt = options.get( "trig_windowpt", 0.0 );
+  triggerSettings.window = options.get( "trig_window", 1.0 );
+  triggerSettings.maxRap = max_track_rap;
+  bool usePerfCounters = options.get( "perf_counters", 0 );
+  std::string workDir = options.get( "work_dir", "" );
+  unsigned long workBlockSize = options.get( "work_blocksize", 1000u );
+  double workTimeout = options.get( "work_timeout", 600.0 );
+  double equivFraction = options.get( "equiv_check", 0.0 );
+  double equivTolerance = options.get( "equiv_tol", 1e-6 );
+  double equivAreaTolerance = options.get( "equiv_areatol", 1e-6 );
+  std::string exportTarget = options.get( "export_target", "" );
+  std::string exportPolicy = options.get( "export_policy", "drop" );
+  unsigned exportQueue = options.get( "export_queue", 256u );
+  double exportPtMin = options.get( "export_ptmin", 1.0 );
+  if ( mpiSize > 1 && !exportTarget.empty() )
+    exportTarget += "_" + patch::to_string( mpiRank );
+  if ( !workDir.empty() && ( mpiSize > 1 || useHepMC || weights.weighted() ) ) {
+    std::cerr<<"Error: work_dir needs unweighted pythia or toy events and no MPI"<<std::endl;
+    return -1;
+  }
+  if ( !workDir.empty() && !stopTargets.empty() ) {
+    std::cerr<<"Warning: sequential stopping is not available with work_dir, ignoring stop_targets"<<std::endl;
+    stopTargets.clear();
+  }
+  if ( !setHistPrecision( options.get( "hist_precision", "double" ) ) )
+    return -1;
+  if ( mpiSize > 1 && !stopTargets.empty() ) {
+    std::cerr<<"Warning: sequential stopping is not available with MPI, ignoring stop_targets"<<std::endl;
+    stopTargets.clear();
+  }
+  options.reportUnused();
+  
   
   // create output histograms using root
-  TH1D* multiplicity = new TH1D("mult", "Visible Multiplicity", 300, -0.5, 899.5 );
-  TH1D* chargedMultiplicity = new TH1D("chargemult", "Charged Multiplicity", 300, -0.5, 899.5 );
+  // toy events can go far beyond the pythia multiplicities
+  double maxMult = useToy ? std::max( 899.5, 3.0 * toySettings.multiplicity - 0.5 ) : 899.5;
+  TH1D* multiplicity = new TH1D("mult", "Visible Multiplicity", 300, -0.5, maxMult );
+  TH1D* chargedMultiplicity = new TH1D("chargemult", "Charged Multiplicity", 300, -0.5, maxMult );
   TH1D* partonPt = new TH1D("partonpt", "Parton Pt", 100, 0, 1000 );
   TH1D* partonE = new TH1D( "parton_e", "Parton Energy", 100, 0, 1000 );
   TH2D* partonEtaPhi = new TH2D("partonetaphi", "Parton Eta x Phi", 100, -5, 5, 100, -TMath::Pi(), TMath::Pi() );
@@ -276,74 +530,94 @@ int main( int argc, const char** argv ) {
   TH1D* nJetsAntiKtBaseCharged = new TH1D("njetsantiktbasecharged", "Jet Multiplicity Anti-Kt Base Charged", 50, 49.5, 299.5);
   TH1D* nJetsKtBaseCharged = new TH1D("njetsktbasecharged", "Jet Multiplicity Kt Base Charged", 50, 49.5, 299.5);
   TH1D* nJetsCaBaseCharged = new TH1D("njetsCabasecharged", "Jet Multiplicity CA Base Charged", 50, 49.5, 299.5);
+  TH1D* nJetsBaseAll[3] = { nJetsAntiKtBaseAll, nJetsKtBaseAll, nJetsCaBaseAll };
+  TH1D* nJetsBaseCharged[3] = { nJetsAntiKtBaseCharged, nJetsKtBaseCharged, nJetsCaBaseCharged };
+  
+  // charged jets matched to the nearest full jet within the base radius
+  const char* baseNames[3] = { "antikt", "kt", "ca" };
+  const char* baseTitles[3] = { "Anti-Kt", "Kt", "CA" };
+  TH2D* chargedFracBase[3];
+  TH1D* chargedDRBase[3];
+  for ( int i = 0; i < 3; ++i ) {
+    chargedFracBase[i] = new TH2D( ( std::string( baseNames[i] ) + "basechargedfrac" ).c_str(),
+                                   ( std::string( "Charged / Full Jet Pt vs Full Jet Pt - " ) + baseTitles[i] + " Base" ).c_str(),
+                                   100, 0, 1000, 120, 0, 1.2 );
+    chargedDRBase[i] = new TH1D( ( std::string( baseNames[i] ) + "basechargeddr" ).c_str(),
+                                 ( std::string( "#Delta R Charged - Full Jet - " ) + baseTitles[i] + " Base" ).c_str(),
+                                 100, 0, baseRadius );
+  }
+  JetGrid fullJetGrid( baseRadius );
   
   
   
   // make a histogram for all of the differing radii
   
   // antikt
-  TH2D* nJetsAntiKt = new TH2D( "antiktnjets", "Number of Jets - Anti-Kt", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );
-  TH2D* deltaEAntiKt = new TH2D( "antiktdeltaE", "#Delta E - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
-  TH2D* deltaRAntiKt = new TH2D( "antiktdeltaR", "#Delta R Leading - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
-  TH2D* nPartAntiKt = new TH2D( "antiktnpart", "Number of Particles per Jet - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* nPartLeadAntiKt = new TH2D( "antiktnpartlead", "Number of Particles per Leading Jet - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* timeAntiKt = new TH2D("antiktclustertime", "Time Required to cluster - Anti-Kt", nRadii, -0.5, nRadii-0.5, 500, 0, 20);
-  TH2D* areaAntiKt = new TH2D("antiktarea", "Jet Area - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* areaLeadAntiKt = new TH2D("antiktarealead", "Lead Jet Area - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* ptLeadAntiKt = new TH2D("antiktptlead", "Lead Jet Pt - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* eLeadAntiKt = new TH2D("antiktelead", "Lead Jet Energy - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* etaAntiKt = new TH2D("antikteta", "Jet Eta - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
-  TH2D* etaLeadAntiKt = new TH2D("antiktetalead", "Lead Jet Eta - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
-  TH2D* phiAntiKt = new TH2D("antiktphi", "Jet Phi - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
-  TH2D* phiLeadAntiKt = new TH2D("antiktphilead", "Lead Jet Phi - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* nJetsAntiKt = newRadiusHist( "antiktnjets", "Number of Jets - Anti-Kt", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );
+  TH2* deltaEAntiKt = newRadiusHist( "antiktdeltaE", "#Delta E - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
+  TH2* deltaRAntiKt = newRadiusHist( "antiktdeltaR", "#Delta R Leading - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
+  TH2* nPartAntiKt = newRadiusHist( "antiktnpart", "Number of Particles per Jet - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* nPartLeadAntiKt = newRadiusHist( "antiktnpartlead", "Number of Particles per Leading Jet - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* timeAntiKt = newRadiusHist("antiktclustertime", "Time Required to cluster - Anti-Kt", nRadii, -0.5, nRadii-0.5, 500, 0, 20);
+  TH2* areaAntiKt = newRadiusHist("antiktarea", "Jet Area - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* areaLeadAntiKt = newRadiusHist("antiktarealead", "Lead Jet Area - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* ptLeadAntiKt = newRadiusHist("antiktptlead", "Lead Jet Pt - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* eLeadAntiKt = newRadiusHist("antiktelead", "Lead Jet Energy - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* etaAntiKt = newRadiusHist("antikteta", "Jet Eta - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
+  TH2* etaLeadAntiKt = newRadiusHist("antiktetalead", "Lead Jet Eta - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
+  TH2* phiAntiKt = newRadiusHist("antiktphi", "Jet Phi - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* phiLeadAntiKt = newRadiusHist("antiktphilead", "Lead Jet Phi - Anti-Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
   
   // kt
-  TH2D* nJetsKt = new TH2D( "ktnjets", "Number of Jets - Kt", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );;
-  TH2D* deltaEKt = new TH2D( "ktdeltaE", "#Delta E - Kt", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
-  TH2D* deltaRKt = new TH2D( "ktdeltaR", "#Delta R - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
-  TH2D* nPartKt = new TH2D( "ktnpart", "Number of Particles per Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* nPartLeadKt = new TH2D( "ktnpartlead", "Number of Particles per Leading Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* timeKt = new TH2D("ktclustertime", "Time Required to cluster - Kt", nRadii, -0.5, nRadii-0.5, 500, 0, 20);
-  TH2D* areaKt = new TH2D("ktarea", "Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* areaLeadKt = new TH2D("ktarealead", "Lead Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* ptLeadKt = new TH2D("ktptlead", "Lead Jet Pt - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* eLeadKt = new TH2D("ktelead", "Lead Jet Energy - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* etaKt = new TH2D("kteta", "Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
-  TH2D* etaLeadKt = new TH2D("ktetalead", "Lead Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
-  TH2D* phiKt = new TH2D("ktphi", "Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
-  TH2D* phiLeadKt = new TH2D("ktphilead", "Lead Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* nJetsKt = newRadiusHist( "ktnjets", "Number of Jets - Kt", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );;
+  TH2* deltaEKt = newRadiusHist( "ktdeltaE", "#Delta E - Kt", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
+  TH2* deltaRKt = newRadiusHist( "ktdeltaR", "#Delta R - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
+  TH2* nPartKt = newRadiusHist( "ktnpart", "Number of Particles per Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* nPartLeadKt = newRadiusHist( "ktnpartlead", "Number of Particles per Leading Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* timeKt = newRadiusHist("ktclustertime", "Time Required to cluster - Kt", nRadii, -0.5, nRadii-0.5, 500, 0, 20);
+  TH2* areaKt = newRadiusHist("ktarea", "Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* areaLeadKt = newRadiusHist("ktarealead", "Lead Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* ptLeadKt = newRadiusHist("ktptlead", "Lead Jet Pt - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* eLeadKt = newRadiusHist("ktelead", "Lead Jet Energy - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* etaKt = newRadiusHist("kteta", "Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
+  TH2* etaLeadKt = newRadiusHist("ktetalead", "Lead Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
+  TH2* phiKt = newRadiusHist("ktphi", "Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* phiLeadKt = newRadiusHist("ktphilead", "Lead Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
 
   // cambridge
-  TH2D* nJetsCa = new TH2D( "canjets", "Number of Jets - CA", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );
-  TH2D* deltaECa = new TH2D( "cadeltaE", "#Delta E - CA", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
-  TH2D* deltaRCa = new TH2D( "cadeltaR", "#Delta R Leading - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
-  TH2D* nPartCa = new TH2D( "canpart", "Number of Particles per Jet - CA", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* nPartLeadCa = new TH2D( "canpartlead", "Number of Particles per Leading Jet - CA", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* timeCa = new TH2D("caclustertime", "Time Required to cluster - CA", nRadii, -0.5, nRadii-0.5, 500, 0, 20);
-  TH2D* areaCa = new TH2D("caarea", "Jet Area - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* areaLeadCa = new TH2D("caarealead", "Lead Jet Area - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* ptLeadCa = new TH2D("captlead", "Lead Jet Pt - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* eLeadCa = new TH2D("caelead", "Lead Jet Energy - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* etaCa = new TH2D("caeta", "Jet Eta - CA", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
-  TH2D* etaLeadCa = new TH2D("caetalead", "Lead Jet Eta - CA", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
-  TH2D* phiCa = new TH2D("caphi", "Jet Phi - CA", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
-  TH2D* phiLeadCa = new TH2D("caphilead", "Lead Jet Phi - CA", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* nJetsCa = newRadiusHist( "canjets", "Number of Jets - CA", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );
+  TH2* deltaECa = newRadiusHist( "cadeltaE", "#Delta E - CA", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
+  TH2* deltaRCa = newRadiusHist( "cadeltaR", "#Delta R Leading - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
+  TH2* nPartCa = newRadiusHist( "canpart", "Number of Particles per Jet - CA", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* nPartLeadCa = newRadiusHist( "canpartlead", "Number of Particles per Leading Jet - CA", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* timeCa = newRadiusHist("caclustertime", "Time Required to cluster - CA", nRadii, -0.5, nRadii-0.5, 500, 0, 20);
+  TH2* areaCa = newRadiusHist("caarea", "Jet Area - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* areaLeadCa = newRadiusHist("caarealead", "Lead Jet Area - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* ptLeadCa = newRadiusHist("captlead", "Lead Jet Pt - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* eLeadCa = newRadiusHist("caelead", "Lead Jet Energy - CA", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* etaCa = newRadiusHist("caeta", "Jet Eta - CA", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
+  TH2* etaLeadCa = newRadiusHist("caetalead", "Lead Jet Eta - CA", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
+  TH2* phiCa = newRadiusHist("caphi", "Jet Phi - CA", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* phiLeadCa = newRadiusHist("caphilead", "Lead Jet Phi - CA", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
   
   // siscone
-  TH2D* nJetsSIS = new TH2D( "sisnjets", "Number of Jets - Kt", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );;
-  TH2D* deltaESIS = new TH2D( "sisdeltaE", "#Delta E - Kt", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
-  TH2D* deltaRSIS = new TH2D( "sisdeltaR", "#Delta R - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
-  TH2D* nPartSIS = new TH2D( "sisnpart", "Number of Particles per Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* nPartLeadSIS = new TH2D( "sisnpartlead", "Number of Particles per Leading Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
-  TH2D* timeSIS = new TH2D("sisclustertime", "Time Required to cluster - Kt", nRadii, -0.5, nRadii-0.5, 500, 0, 20000);
-  TH2D* areaSIS = new TH2D("sisarea", "Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* areaLeadSIS = new TH2D("sisarealead", "Lead Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
-  TH2D* ptLeadSIS = new TH2D("sisptlead", "Lead Jet Pt - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* eLeadSIS = new TH2D("siselead", "Lead Jet Energy - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
-  TH2D* etaSIS = new TH2D("siseta", "Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
-  TH2D* etaLeadSIS = new TH2D("sisetalead", "Lead Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
-  TH2D* phiSIS = new TH2D("sisphi", "Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
-  TH2D* phiLeadSIS = new TH2D("sisphilead", "Lead Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* nJetsSIS = newRadiusHist( "sisnjets", "Number of Jets - Kt", nRadii, -0.5, nRadii-0.5, 300, -0.5, 599.5 );;
+  TH2* deltaESIS = newRadiusHist( "sisdeltaE", "#Delta E - Kt", nRadii, -0.5, nRadii-0.5, 100, -100, 100 );
+  TH2* deltaRSIS = newRadiusHist( "sisdeltaR", "#Delta R - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2.0 );
+  TH2* nPartSIS = newRadiusHist( "sisnpart", "Number of Particles per Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* nPartLeadSIS = newRadiusHist( "sisnpartlead", "Number of Particles per Leading Jet - Kt", nRadii, -0.5, nRadii-0.5, 100, -0.5, 599.5 );
+  TH2* timeSIS = newRadiusHist("sisclustertime", "Time Required to cluster - Kt", nRadii, -0.5, nRadii-0.5, 500, 0, 20000);
+  TH2* areaSIS = newRadiusHist("sisarea", "Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* areaLeadSIS = newRadiusHist("sisarealead", "Lead Jet Area - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 2*TMath::Pi() );
+  TH2* ptLeadSIS = newRadiusHist("sisptlead", "Lead Jet Pt - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* eLeadSIS = newRadiusHist("siselead", "Lead Jet Energy - Kt", nRadii, -0.5, nRadii-0.5, 100, 0, 1000 );
+  TH2* etaSIS = newRadiusHist("siseta", "Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap );
+  TH2* etaLeadSIS = newRadiusHist("sisetalead", "Lead Jet Eta - Kt", nRadii, -0.5, nRadii-0.5, 100, -max_rap, max_rap);
+  TH2* phiSIS = newRadiusHist("sisphi", "Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* phiLeadSIS = newRadiusHist("sisphilead", "Lead Jet Phi - Kt", nRadii, -0.5, nRadii-0.5, 100, -TMath::Pi(), TMath::Pi() );
+  TH2* nStableSIS = newRadiusHist("sisnstable", "Number of Stable Cones - SISCone", nRadii, -0.5, nRadii-0.5, 200, -0.5, 1999.5 );
+  TH1D* eventTimeSIS = new TH1D("sisevttime", "Wall Time for the SISCone Radius Sweep", 500, 0, 20000 );
+  TH1D* prepTime = new TH1D("evtpreptime", "Time for the Shared Event Preprocessing", 500, 0, 50 );
   // set bin labels to radii
   for ( int i = 1; i <= nRadii; ++i ) {
 
@@ -406,229 +680,533 @@ int main( int argc, const char** argv ) {
     etaLeadSIS->GetXaxis()->SetBinLabel( i, patch::to_string( radii[i-1]).c_str() );
     phiSIS->GetXaxis()->SetBinLabel( i, patch::to_string( radii[i-1]).c_str() );
     phiLeadSIS->GetXaxis()->SetBinLabel( i, patch::to_string( radii[i-1]).c_str() );
+    nStableSIS->GetXaxis()->SetBinLabel( i, patch::to_string( radii[i-1]).c_str() );
 
   }
   
+  // clustering time against input size, for the scaling fit
+  const char* jetfinderNames[] = { "antikt", "kt", "ca", "sis" };
+  std::vector<std::string> radiusLabels;
+  for ( int i = 0; i < nRadii; ++i )
+    radiusLabels.push_back( patch::to_string( radii[i] ) );
+  ClusterScaling scaling( std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radiusLabels );
+  
+  // energy correlators of the leading jets
+  JetEEC eec( std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radiusLabels, eecMaxN );
+  
+  // girth, lambda2, ptD and mass of the inclusive and leading jets
+  JetShapes shapes( std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radiusLabels );
+  JetMembership members[4];
+  
+  // soft drop, trimming and filtering of the leading jets, CA
+  // jets ( index 2 ) are groomed through their own history
+  JetGroomer groomer( std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radiusLabels, groomSettings, 2 );
+  
+  // every jet above matchPtMin matched to the partons, to the
+  // anti-kt jets and to the jets of the previous radius
+  JetMatchStudy matchStudy( std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radiusLabels, matchPtMin );
+  
+  // rejects events before they reach the clustering
+  EventTrigger trigger( triggerSettings );
+  
+  // approximate leading jets, with the full clustering on a sample
+  FastLeadJet fastLead( fastLeadMode, fastLeadFraction, radii, radiusLabels, max_rap );
+  
+  // production clusterings checked against the plain path
+  ClusterEquivalence equivalence( equivFraction, equivTolerance, equivAreaTolerance,
+                                  std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radii, radiusLabels, sisSettings );
+  
+  // jets streamed to an online consumer
+  JetExport exporter( exportTarget, exportPolicy, exportQueue, exportPtMin,
+                      std::vector<std::string>( jetfinderNames, jetfinderNames + 4 ), radii );
+  
+  // hardware counters per stage, clusterStages[ jetfinder * nRadii + radius ]
+  PerfCounters perf( usePerfCounters );
+  unsigned generationStage = perf.addStage( "generation" );
+  unsigned conversionStage = perf.addStage( "conversion" );
+  unsigned preparationStage = perf.addStage( "preparation" );
+  unsigned sisStage = perf.addStage( "sis" );
+  std::vector<unsigned> clusterStages;
+  for ( int j = 0; j < 3; ++j )
+    for ( int i = 0; i < nRadii; ++i )
+      clusterStages.push_back( perf.addStage( std::string( jetfinderNames[j] ) + "_" + radiusLabels[i] ) );
+  
+  // sequential stopping looks the target histograms up by name,
+  // so it has to be set up after they are created
+  SequentialStop stopper( stopTargets, stopPrecision, stopInterval );
+  
+  // blocks of events leased from work_dir, each with its own seed
+  WorkQueue work( workDir, maxEvent, workBlockSize, seed, workTimeout );
+  unsigned blockEnd = 0;
+  
+  // what the sweep costs in histogram memory
+  if ( mpiRank == 0 )
+    reportHistogramMemory( gDirectory, radiusLabels );
+  
+  // in the weighted modes every booked histogram is normalized
+  // to the cross section of its pT-hat bin
+  weights.collect( gDirectory );
+  
+  // live snapshots of everything booked so far
+  HistSnapshotWriter snapshots( gDirectory, snapshotFile, snapshotInterval );
+  
   // start the event loop from event 0
   unsigned currentEvent = 0;
+  unsigned binStartEvent = 0;
+  unsigned long inputEvent = 0;
+  std::chrono::time_point<clock> loop_start = clock::now();
+  telemetry.start( telemetryFile, telemetryInterval, progressInterval );
+  // every generated event ends here, clustered or not: telemetry,
+  // snapshots and the stopping decision. returns true to stop
+  auto eventDone = [&]() {
+    telemetry.eventDone();
+    snapshots.update( currentEvent );
+    return stopper.done( currentEvent );
+  };
+  
+  // the stages of the sweep: hardware counters, telemetry, and
+  // the equivalence check, which saves the ghost random state
+  // around the input preparation
+  jetFinder.onBegin( [&]( const jetfind::Step& step ) {
+    if ( step.kind == jetfind::Step::prepare )
+      equivalence.beginEvent( area_spec );
+    if ( step.kind != jetfind::Step::cluster || !step.charged )
+      perf.begin();
+  } );
+  jetFinder.onEnd( [&]( const jetfind::Step& step ) {
+    if ( step.kind == jetfind::Step::prepare ) {
+      perf.end( preparationStage, step.inputs );
+      equivalence.prepared( area_spec, step.time );
+      prepTime->Fill( step.time );
+    }
+    else if ( step.kind == jetfind::Step::sisCone ) {
+      perf.end( sisStage, step.inputs );
+      eventTimeSIS->Fill( step.time );
+      telemetry.addClusterTime( 3, std::chrono::duration<double, std::milli>( step.time ) );
+    }
+    else {
+      if ( !step.charged )
+        perf.end( clusterStages[step.algorithm * nRadii + step.radiusIndex], step.inputs );
+      telemetry.addClusterTime( step.algorithm, std::chrono::duration<double, std::milli>( step.time ) );
+    }
+  } );
+  
+  // the histograms of one radius, once every jetfinder has run
+  jetFinder.onRadius( [&]( const jetfind::RadiusSets& sets ) {
+    
+    
+    const int i = sets.radiusIndex;
+    const double weight = sets.weight;
+    std::string radBin = patch::to_string( radii[i] );
+    
+    // the clusterings of this radius, timed by the sweep
+    const jetfind::JetSet& antiKt = *sets.full[jetfind::antikt];
+    const jetfind::JetSet& kt = *sets.full[jetfind::kt];
+    const jetfind::JetSet& ca = *sets.full[jetfind::ca];
+    const jetfind::JetSet& sisCone = *sets.full[jetfind::sis];
+    const fastjet::ClusterSequenceAreaBase& clusterAntiKt = antiKt.sequence;
+    const fastjet::ClusterSequenceAreaBase& clusterKt = kt.sequence;
+    const fastjet::ClusterSequenceAreaBase& clusterCa = ca.sequence;
+    const fastjet::ClusterSequenceAreaBase& clusterSIS = sisCone.sequence;
+    double antiKtTime = antiKt.time;
+    double ktTime = kt.time;
+    double caTime = ca.time;
+    double SISTime = sisCone.time;
+    scaling.fill( 0, i, clusterAntiKt.n_particles(), antiKtTime );
+    scaling.fill( 1, i, clusterKt.n_particles(), ktTime );
+    scaling.fill( 2, i, clusterCa.n_particles(), caTime );
+    scaling.fill( 3, i, sisRunner.nInputs( i ), SISTime );
+    nStableSIS->Fill( radBin.c_str(), sisRunner.nStableCones( i ), weight );
+    
+    // fill timing measurements
+    timeAntiKt->Fill( radBin.c_str(), antiKtTime, 1 );
+    timeKt->Fill( radBin.c_str(), ktTime, 1 );
+    timeCa->Fill( radBin.c_str(), caTime, 1 );
+    timeSIS->Fill( radBin.c_str(), SISTime, 1 );
+    
+    const std::vector<fastjet::PseudoJet>& antiKtJets = antiKt.jets;
+    const std::vector<fastjet::PseudoJet>& KtJets = kt.jets;
+    const std::vector<fastjet::PseudoJet>& CaJets = ca.jets;
+    const std::vector<fastjet::PseudoJet>& SISJets = sisCone.jets;
+    if ( equivalence.checking() ) {
+      const fastjet::JetDefinition* equivDefs[4] = { &antiKt.definition, &kt.definition, &ca.definition, &equivalence.sisDefinition( i ) };
+      const std::vector<fastjet::PseudoJet>* equivJets[4] = { &antiKtJets, &KtJets, &CaJets, &SISJets };
+      const double equivTimes[4] = { antiKtTime, ktTime, caTime, SISTime };
+      for ( int k = 0; k < 4; ++k )
+        equivalence.compare( currentEvent, k, i, allFinal, *equivDefs[k], area_def, *equivJets[k], equivTimes[k] );
+    }
+    // the inputs of every jet, shared by the constituent counts,
+    // the shapes and the export
+    members[0].build( clusterAntiKt, antiKtJets );
+    members[1].build( clusterKt, KtJets );
+    members[2].build( clusterCa, CaJets );
+    members[3].build( clusterSIS, SISJets );
+    exporter.add( 0, i, antiKtJets, &members[0] );
+    exporter.add( 1, i, KtJets, &members[1] );
+    exporter.add( 2, i, CaJets, &members[2] );
+    exporter.add( 3, i, SISJets, &members[3] );
+    // now start to fill histograms
+    // first, number of jets in the event
+    nJetsAntiKt->Fill ( radBin.c_str(), antiKtJets.size(), weight );
+    nJetsKt->Fill ( radBin.c_str(), KtJets.size(), weight );
+    nJetsCa->Fill ( radBin.c_str(), CaJets.size(), weight );
+    nJetsSIS->Fill( radBin.c_str(), SISJets.size(), weight );
+    
+    // now, we'll do number of particles, and area, for both both leading jets and inclusive jets
+    nPartLeadAntiKt->Fill ( radBin.c_str(), members[0].size( 0 ), weight );
+    nPartLeadKt->Fill ( radBin.c_str(), members[1].size( 0 ), weight );
+    nPartLeadCa->Fill ( radBin.c_str(), members[2].size( 0 ), weight );
+    nPartLeadSIS->Fill ( radBin.c_str(), members[3].size( 0 ), weight );
+    areaLeadAntiKt->Fill ( radBin.c_str(), antiKtJets[0].area(), weight );
+    areaLeadKt->Fill ( radBin.c_str(), KtJets[0].area(), weight );
+    areaLeadCa->Fill ( radBin.c_str(), CaJets[0].area(), weight );
+    areaLeadSIS->Fill( radBin.c_str(), SISJets[0].area(), weight );
+
+    // fill leading jet spectra
+    ptLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].pt(), weight );
+    eLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].E(), weight );
+    ptLeadKt->Fill( radBin.c_str(), KtJets[0].pt(), weight );
+    eLeadKt->Fill( radBin.c_str(), KtJets[0].E(), weight );
+    ptLeadCa->Fill( radBin.c_str(), CaJets[0].pt(), weight );
+    eLeadCa->Fill( radBin.c_str(), CaJets[0].E(), weight );
+    ptLeadSIS->Fill( radBin.c_str(), SISJets[0].pt(), weight );
+    eLeadSIS->Fill( radBin.c_str(), SISJets[0].E(), weight );
+    
+    // leading jet eta & phi
+    etaLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].eta(), weight );
+    phiLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].phi_std(), weight );
+    etaLeadKt->Fill( radBin.c_str(), KtJets[0].eta(), weight );
+    phiLeadKt->Fill( radBin.c_str(), KtJets[0].phi_std(), weight );
+    etaLeadCa->Fill( radBin.c_str(), CaJets[0].eta(), weight );
+    phiLeadCa->Fill( radBin.c_str(), CaJets[0].phi_std(), weight );
+    etaLeadSIS->Fill( radBin.c_str(), SISJets[0].eta(), weight );
+    phiLeadSIS->Fill( radBin.c_str(), SISJets[0].phi_std(), weight );
+    
+    // the approximate leading jet against anti-kt
+    fastLead.validate( i, antiKtJets[0], weight );
+    
+    // leading jet energy correlators
+    eec.fill( 0, i, members[0], antiKtJets[0], weight );
+    eec.fill( 1, i, members[1], KtJets[0], weight );
+    eec.fill( 2, i, members[2], CaJets[0], weight );
+    eec.fill( 3, i, members[3], SISJets[0], weight );
+    
+    // jet shapes, from the inputs of every jet
+    shapes.fill( 0, i, radii[i], members[0], antiKtJets, weight );
+    shapes.fill( 1, i, radii[i], members[1], KtJets, weight );
+    shapes.fill( 2, i, radii[i], members[2], CaJets, weight );
+    shapes.fill( 3, i, radii[i], members[3], SISJets, weight );
+    
+    // groomed leading jets
+    groomer.fill( 0, i, radii[i], antiKtJets[0], weight );
+    groomer.fill( 1, i, radii[i], KtJets[0], weight );
+    groomer.fill( 2, i, radii[i], CaJets[0], weight );
+    groomer.fill( 3, i, radii[i], SISJets[0], weight );
+    
+    // jet matching, all jets of every jetfinder
+    std::vector<const std::vector<fastjet::PseudoJet>*> allJets;
+    allJets.push_back( &antiKtJets );
+    allJets.push_back( &KtJets );
+    allJets.push_back( &CaJets );
+    allJets.push_back( &SISJets );
+    matchStudy.fill( i, radii[i], allJets, partons, weight );
+    
+    for ( int j = 0; j < antiKtJets.size(); ++j ) {
+      nPartAntiKt->Fill ( radBin.c_str(), members[0].size( j ), weight );
+      areaAntiKt->Fill ( radBin.c_str(), antiKtJets[j].area(), weight );
+      etaAntiKt->Fill( radBin.c_str(), antiKtJets[j].eta(), weight );
+      phiAntiKt->Fill( radBin.c_str(), antiKtJets[j].phi_std(), weight );
+    }
+    for ( int j = 0; j < KtJets.size(); ++j ) {
+      nPartKt->Fill ( radBin.c_str(), members[1].size( j ), weight );
+      areaKt->Fill ( radBin.c_str(), KtJets[j].area(), weight );
+      etaKt->Fill( radBin.c_str(), KtJets[j].eta(), weight );
+      phiKt->Fill( radBin.c_str(), KtJets[j].phi_std(), weight );
+    }
+    for ( int j = 0; j < CaJets.size(); ++j ) {
+      nPartCa->Fill ( radBin.c_str(), members[2].size( j ), weight );
+      areaCa->Fill ( radBin.c_str(), CaJets[j].area(), weight );
+      etaCa->Fill( radBin.c_str(), CaJets[j].eta(), weight );
+      phiCa->Fill( radBin.c_str(), CaJets[j].phi_std(), weight );
+    }
+    for ( int j = 0; j < SISJets.size(); ++j ) {
+      nPartSIS->Fill( radBin.c_str(), members[3].size( j ), weight );
+      areaSIS->Fill( radBin.c_str(), SISJets[j].area(), weight );
+      etaSIS->Fill( radBin.c_str(), SISJets[j].eta(), weight );
+      phiSIS->Fill( radBin.c_str(), SISJets[j].phi_std(), weight );
+    }
+    
+    // and compare to the initial partons for delta E and delta R
+    // we find the minimum of the delta R between leading jet and parton1 and parton2
+    // and use that as the base for both delta R and delta E
+    
+    // first antikt
+    double distToPart1 = partons[0].delta_R(antiKtJets[0]);
+    double distToPart2 = partons[1].delta_R(antiKtJets[0]);
+    int partonIdx = 0;
+    if ( distToPart2 < distToPart1 )
+      partonIdx = 1;
+    deltaRAntiKt->Fill ( radBin.c_str(), partons[partonIdx].delta_R( antiKtJets[0] ), weight );
+    deltaEAntiKt->Fill ( radBin.c_str(), partons[partonIdx].E() - antiKtJets[0].E(), weight );
+    
+    // repeat for Kt, Ca and SIScone
+    distToPart1 = partons[0].delta_R( KtJets[0] );
+    distToPart2 = partons[1].delta_R( KtJets[0] );
+    partonIdx = 0;
+    if ( distToPart2 < distToPart1 )
+      partonIdx = 1;
+    deltaRKt->Fill ( radBin.c_str(), partons[partonIdx].delta_R( KtJets[0] ), weight );
+    deltaEKt->Fill ( radBin.c_str(), partons[partonIdx].E() - KtJets[0].E(), weight );
+    
+    distToPart1 = partons[0].delta_R( CaJets[0] );
+    distToPart2 = partons[1].delta_R( CaJets[0] );
+    partonIdx = 0;
+    if ( distToPart2 < distToPart1 )
+      partonIdx = 1;
+    deltaRCa->Fill ( radBin.c_str(), partons[partonIdx].delta_R( CaJets[0] ), weight );
+    deltaECa->Fill ( radBin.c_str(), partons[partonIdx].E() - CaJets[0].E(), weight );
+    
+    distToPart1 = partons[0].delta_R( SISJets[0] );
+    distToPart2 = partons[1].delta_R( SISJets[0] );
+    partonIdx = 0;
+    if ( distToPart2 < distToPart1 )
+      partonIdx = 1;
+    deltaRSIS->Fill ( radBin.c_str(), partons[partonIdx].delta_R( SISJets[0] ), weight );
+    deltaESIS->Fill ( radBin.c_str(), partons[partonIdx].E() - SISJets[0].E(), weight );
+    
+    // charged jets at the base radius, clustered in the same pass
+    // with the same ghosts, and matched to the full jets above
+    if ( sets.charged[jetfind::antikt] ) {
+      const fastjet::ClusterSequenceAreaBase* fullSequences[3] = { &clusterAntiKt, &clusterKt, &clusterCa };
+      const std::vector<fastjet::PseudoJet>* fullJets[3] = { &antiKtJets, &KtJets, &CaJets };
+      for ( int k = 0; k < 3; ++k ) {
+        const jetfind::JetSet& clusterCharged = *sets.charged[k];
+        
+        nJetsBaseAll[k]->Fill( fullSequences[k]->inclusive_jets().size(), weight );
+        nJetsBaseCharged[k]->Fill( clusterCharged.sequence.inclusive_jets().size(), weight );
+        
+        const std::vector<fastjet::PseudoJet>& chargedJets = clusterCharged.jets;
+        fullJetGrid.build( *fullJets[k] );
+        for ( int j = 0; j < chargedJets.size(); ++j ) {
+          int match = fullJetGrid.nearest( chargedJets[j] );
+          if ( match < 0 )
+            continue;
+          const fastjet::PseudoJet& full = ( *fullJets[k] )[match];
+          chargedFracBase[k]->Fill( full.pt(), chargedJets[j].pt() / full.pt(), weight );
+          chargedDRBase[k]->Fill( chargedJets[j].delta_R( full ), weight );
+        }
+      }
+    }
+  } );
   try{
     while ( currentEvent < maxEvent ) {
+      // move on to the next pT-hat bin once the current one is full
+      if ( usePythia && currentEvent == weights.binEnd( weights.currentBin(), maxEvent ) && weights.currentBin() + 1 < weights.nBins() ) {
+        weights.endBin( *pythia, currentEvent - binStartEvent );
+        binStartEvent = currentEvent;
+        startup.initStart();
+        weights.initBin( *pythia, weights.currentBin() + 1 );
+        startup.initDone();
+      }
+      
       // try to generate a new event
       // if it fails, iterate without incrementing
       // current event number
       
-      if ( !pythia.next() )
+      // in work mode, store the finished block and lease the next
+      if ( work.enabled() && currentEvent == blockEnd ) {
+        work.complete( gDirectory );
+        unsigned long blockEvents;
+        unsigned blockSeed;
+        if ( !work.claim( blockEvents, blockSeed ) )
+          break;
+        blockEnd = currentEvent + blockEvents;
+        if ( usePythia )
+          pythia->rndm.init( blockSeed );
+        else
+          toy.reseed( blockSeed );
+      }
+      work.heartbeat();
+      if ( work.lost() )
+        break;
+      
+      double weight = 1.0;
+      perf.begin();
+      if ( useToy ) {
+        toy.next( sourceParticles, sourceCharged, sourcePartons );
+      }
+      else if ( useHepMC ) {
+        // stop at the end of the file, skip events without both partons
+        if ( !hepmc.next( sourceParticles, sourceCharged, sourcePartons, weight ) )
+          break;
+        // with MPI the file is shared round robin between the ranks
+        if ( inputEvent++ % mpiSize != (unsigned) mpiRank )
+          continue;
+        if ( sourcePartons.size() < 2 )
+          continue;
+      }
+      else if ( !pythia->next() )
         continue;
       
-      // pythia succeeded, so increment the event
+      // generation succeeded, so increment the event
       currentEvent++;
-
-      // output event number
-      if ( currentEvent%50 == 0 )
-        std::cout<<"Event: "<<currentEvent<<std::endl;
+      startup.firstEvent();
+      perf.end( generationStage );
       
-      // convert pythia particles into useable pseudojets,
-      // only take those in our eta range && that are visible
-      // in conventional detectors
+      // every histogram fill carries the event weight
+      if ( usePythia )
+        weight = weights.eventWeight( *pythia );
+
+      // the sweep converts the particles into useable pseudojets,
+      // only taking those in our eta range ( of pythia's, those
+      // that are visible in conventional detectors )
       // note: particles user_index() is the charge
-      // if partons are outside
-      convertToPseudoJet( pythia, max_track_rap, allFinal, chargedFinal, partons );
+      // events with a parton outside are not clustered
+      perf.begin();
+      bool loaded;
+      if ( usePythia ) {
+        readPythiaEvent( *pythia, pythiaParticles, pythiaPartons );
+        loaded = jetFinder.load( pythiaParticles, pythiaPartons );
+      }
+      else
+        loaded = jetFinder.load( sourceParticles, sourcePartons );
+      perf.end( conversionStage, allFinal.size() );
+      perf.addParticles( generationStage, allFinal.size() );
+      if ( !loaded ) {
+        if ( eventDone() )
+          break;
+        continue;
+      }
+      
+      // cheap criteria on the particles, rejected events are
+      // counted but never clustered
+      if ( !trigger.accept( allFinal, partons, weight ) ) {
+        if ( eventDone() )
+          break;
+        continue;
+      }
+
+      // with fastlead every event gets its approximate leading
+      // jets, and only the validation sample goes on, with the
+      // weight scaled up to keep the normalization of every
+      // histogram filled below
+      fastLead.find( allFinal, partons, weight );
+      if ( !fastLead.sample() ) {
+        if ( eventDone() )
+          break;
+        continue;
+      }
+      weight *= fastLead.sampleWeight();
 
       // event information
-      multiplicity->Fill( allFinal.size() );
-      chargedMultiplicity->Fill( chargedFinal.size() );
+      multiplicity->Fill( allFinal.size(), weight );
+      chargedMultiplicity->Fill( chargedFinal.size(), weight );
       
       // fill parton information
       for ( int i = 0; i < 2; ++i ) {
-        partonEtaPhi->Fill( partons[i].eta(), partons[i].phi_std() );
-        partonPt->Fill( partons[i].pt() );
-        partonE->Fill( partons[i].E() );
+        partonEtaPhi->Fill( partons[i].eta(), partons[i].phi_std(), weight );
+        partonPt->Fill( partons[i].pt(), weight );
+        partonE->Fill( partons[i].E(), weight );
       }
       
       // now fill track information
       for ( int i = 0; i < allFinal.size(); ++i ) {
-        visiblePt->Fill( allFinal[i].pt() );
-        visibleE->Fill( allFinal[i].E() );
-        visibleEtaPhi->Fill( allFinal[i].eta(), allFinal[i].phi_std() );
+        visiblePt->Fill( allFinal[i].pt(), weight );
+        visibleE->Fill( allFinal[i].E(), weight );
+        visibleEtaPhi->Fill( allFinal[i].eta(), allFinal[i].phi_std(), weight );
       }
       
       for ( int i = 0; i < chargedFinal.size(); ++i ) {
-        chargedPt->Fill( chargedFinal[i].pt() );
-        chargedE->Fill( chargedFinal[i].E() );
-        chargedEtaPhi->Fill( chargedFinal[i].eta(), chargedFinal[i].phi_std() );
+        chargedPt->Fill( chargedFinal[i].pt(), weight );
+        chargedE->Fill( chargedFinal[i].E(), weight );
+        chargedEtaPhi->Fill( chargedFinal[i].eta(), chargedFinal[i].phi_std(), weight );
       }
       
-      // // now set up the clustering
-      // fastjet::ClusterSequenceArea clusterAntiKtAll ( allFinal, antiKtBase, area_def );
-      // std::vector<fastjet::PseudoJet> antiKtBaseJets = fastjet::sorted_by_pt(clusterAntiKtAll.inclusive_jets());
-      // fastjet::ClusterSequenceArea clusterKtAll ( allFinal, KtBase, area_def );
-      // std::vector<fastjet::PseudoJet> KtBaseJets = fastjet::sorted_by_pt(clusterKtAll.inclusive_jets());
-      // fastjet::ClusterSequenceArea clusterCaAll ( allFinal, CaBase, area_def );
-      // std::vector<fastjet::PseudoJet> CaBaseJets = fastjet::sorted_by_pt(clusterCaAll.inclusive_jets());
-      // fastjet::ClusterSequenceArea clusterAntiKtCharged ( chargedFinal, antiKtBase, area_def );
-      // std::vector<fastjet::PseudoJet> antiKtChargedJets = fastjet::sorted_by_pt(clusterAntiKtCharged.inclusive_jets());
-      // fastjet::ClusterSequenceArea clusterKtCharged ( chargedFinal, KtBase, area_def );
-      // std::vector<fastjet::PseudoJet> KtChargedJets = fastjet::sorted_by_pt(clusterKtCharged.inclusive_jets());
-      // fastjet::ClusterSequenceArea clusterCaCharged ( chargedFinal, CaBase, area_def );
-      // std::vector<fastjet::PseudoJet> CaChargedJets = fastjet::sorted_by_pt(clusterCaCharged.inclusive_jets());
-
-      // // plot the number of jets by the different algorithms
-      // nJetsAntiKtBaseAll->Fill( antiKtBaseJets.size() );
-      // nJetsKtBaseAll->Fill( KtBaseJets.size() );
-      // nJetsCaBaseAll->Fill( CaBaseJets.size() );
-      // nJetsAntiKtBaseCharged->Fill( antiKtChargedJets.size() );
-      // nJetsKtBaseCharged->Fill( KtChargedJets.size() );
-      // nJetsCaBaseCharged->Fill( CaChargedJets.size() );
-
-      // now we'll do the loop over differing radii
-      for ( int i = 0; i < nRadii; ++i ) {
-        
-        
-        std::string radBin = patch::to_string( radii[i] );
-        
-        // first perform the clustering
-        
-        // time the clustering as well
-        std::chrono::time_point<clock> start = clock::now();
-        
-        fastjet::ClusterSequenceArea clusterAntiKt( allFinal, antiKtDefs[i], area_def );
-        //fastjet::ClusterSequence clusterAntiKt( allFinal, antiKtDefs[i] );
-        double antiKtTime = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
-        start = clock::now();
-        
-        fastjet::ClusterSequenceArea clusterKt( allFinal, KtDefs[i], area_def );
-        //fastjet::ClusterSequence clusterKt( allFinal, KtDefs[i] );
-        double ktTime = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
-        start = clock::now();
-        
-        fastjet::ClusterSequenceArea clusterCa( allFinal, CaDefs[i], area_def );
-        //fastjet::ClusterSequence clusterCa( allFinal, CaDefs[i] );
-        double caTime = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
-        start = clock::now();
-
-        fastjet::ClusterSequenceArea clusterSIS( allFinal, SISDefs[i], area_def );
-        double SISTime = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
-        
-        // fill timing measurements
-        timeAntiKt->Fill( radBin.c_str(), antiKtTime, 1 );
-        timeKt->Fill( radBin.c_str(), ktTime, 1 );
-        timeCa->Fill( radBin.c_str(), caTime, 1 );
-        timeSIS->Fill( radBin.c_str(), SISTime, 1 );
-        
-        std::vector<fastjet::PseudoJet> antiKtJets = fastjet::sorted_by_pt( fastjet::SelectorPtMin(1.0)(clusterAntiKt.inclusive_jets()) );
-        std::vector<fastjet::PseudoJet> KtJets = fastjet::sorted_by_pt( fastjet::SelectorPtMin(1.0)(clusterKt.inclusive_jets()) );
-        std::vector<fastjet::PseudoJet> CaJets = fastjet::sorted_by_pt( fastjet::SelectorPtMin(1.0)(clusterCa.inclusive_jets()) );
-        std::vector<fastjet::PseudoJet> SISJets = fastjet::sorted_by_pt( fastjet::SelectorPtMin(1.0)(clusterSIS.inclusive_jets()) );
-        // now start to fill histograms
-        // first, number of jets in the event
-        nJetsAntiKt->Fill ( radBin.c_str(), antiKtJets.size(), 1 );
-        nJetsKt->Fill ( radBin.c_str(), KtJets.size(), 1 );
-        nJetsCa->Fill ( radBin.c_str(), CaJets.size(), 1 );
-        nJetsSIS->Fill( radBin.c_str(), SISJets.size(), 1 );
-        
-        // now, we'll do number of particles, and area, for both both leading jets and inclusive jets
-        nPartLeadAntiKt->Fill ( radBin.c_str(), antiKtJets[0].constituents().size(), 1 );
-        nPartLeadKt->Fill ( radBin.c_str(), KtJets[0].constituents().size(), 1 );
-        nPartLeadCa->Fill ( radBin.c_str(), CaJets[0].constituents().size(), 1 );
-        nPartLeadSIS->Fill ( radBin.c_str(), SISJets[0].constituents().size(), 1 );
-        areaLeadAntiKt->Fill ( radBin.c_str(), antiKtJets[0].area(), 1 );
-        areaLeadKt->Fill ( radBin.c_str(), KtJets[0].area(), 1 );
-        areaLeadCa->Fill ( radBin.c_str(), CaJets[0].area(), 1 );
-        areaLeadSIS->Fill( radBin.c_str(), SISJets[0].area(), 1 );
-
-        // fill leading jet spectra
-        ptLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].pt(), 1 );
-        eLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].E(), 1 );
-        ptLeadKt->Fill( radBin.c_str(), KtJets[0].pt(), 1 );
-        eLeadKt->Fill( radBin.c_str(), KtJets[0].E(), 1 );
-        ptLeadCa->Fill( radBin.c_str(), CaJets[0].pt(), 1 );
-        eLeadCa->Fill( radBin.c_str(), CaJets[0].E(), 1 );
-        ptLeadSIS->Fill( radBin.c_str(), SISJets[0].pt(), 1 );
-        eLeadSIS->Fill( radBin.c_str(), SISJets[0].E(), 1 );
-        
-        // leading jet eta & phi
-        etaLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].eta(), 1 );
-        phiLeadAntiKt->Fill( radBin.c_str(), antiKtJets[0].phi_std(), 1 );
-        etaLeadKt->Fill( radBin.c_str(), KtJets[0].eta(), 1 );
-        phiLeadKt->Fill( radBin.c_str(), KtJets[0].phi_std(), 1 );
-        etaLeadCa->Fill( radBin.c_str(), CaJets[0].eta(), 1 );
-        phiLeadCa->Fill( radBin.c_str(), CaJets[0].phi_std(), 1 );
-        etaLeadSIS->Fill( radBin.c_str(), SISJets[0].eta(), 1 );
-        phiLeadSIS->Fill( radBin.c_str(), SISJets[0].phi_std(), 1 );
-        
-        for ( int j = 0; j < antiKtJets.size(); ++j ) {
-          nPartAntiKt->Fill ( radBin.c_str(), antiKtJets[j].constituents().size(), 1 );
-          areaAntiKt->Fill ( radBin.c_str(), antiKtJets[j].area(), 1 );
-          etaAntiKt->Fill( radBin.c_str(), antiKtJets[j].eta(), 1 );
-          phiAntiKt->Fill( radBin.c_str(), antiKtJets[j].phi_std(), 1 );
-        }
-        for ( int j = 0; j < KtJets.size(); ++j ) {
-          nPartKt->Fill ( radBin.c_str(), KtJets[j].constituents().size(), 1 );
-          areaKt->Fill ( radBin.c_str(), KtJets[j].area(), 1 );
-          etaKt->Fill( radBin.c_str(), KtJets[j].eta(), 1 );
-          phiKt->Fill( radBin.c_str(), KtJets[j].phi_std(), 1 );
-        }
-        for ( int j = 0; j < CaJets.size(); ++j ) {
-          nPartCa->Fill ( radBin.c_str(), CaJets[j].constituents().size(), 1 );
-          areaCa->Fill ( radBin.c_str(), CaJets[j].area(), 1 );
-          etaCa->Fill( radBin.c_str(), CaJets[j].eta(), 1 );
-          phiCa->Fill( radBin.c_str(), CaJets[j].phi_std(), 1 );
-        }
-        for ( int j = 0; j < SISJets.size(); ++j ) {
-          nPartSIS->Fill( radBin.c_str(), SISJets[j].constituents().size(), 1 );
-          areaSIS->Fill( radBin.c_str(), SISJets[j].area(), 1 );
-          etaSIS->Fill( radBin.c_str(), SISJets[j].eta(), 1 );
-          phiSIS->Fill( radBin.c_str(), SISJets[j].phi_std(), 1 );
-        }
-        
-        // and compare to the initial partons for delta E and delta R
-        // we find the minimum of the delta R between leading jet and parton1 and parton2
-        // and use that as the base for both delta R and delta E
-        
-        // first antikt
-        double distToPart1 = partons[0].delta_R(antiKtJets[0]);
-        double distToPart2 = partons[1].delta_R(antiKtJets[0]);
-        int partonIdx = 0;
-        if ( distToPart2 < distToPart1 )
-          partonIdx = 1;
-        deltaRAntiKt->Fill ( radBin.c_str(), partons[partonIdx].delta_R( antiKtJets[0] ), 1 );
-        deltaEAntiKt->Fill ( radBin.c_str(), partons[partonIdx].E() - antiKtJets[0].E(), 1 );
-        
-        // repeat for Kt, Ca and SIScone
-        distToPart1 = partons[0].delta_R( KtJets[0] );
-        distToPart2 = partons[1].delta_R( KtJets[0] );
-        partonIdx = 0;
-        if ( distToPart2 < distToPart1 )
-          partonIdx = 1;
-        deltaRKt->Fill ( radBin.c_str(), partons[partonIdx].delta_R( KtJets[0] ), 1 );
-        deltaEKt->Fill ( radBin.c_str(), partons[partonIdx].E() - KtJets[0].E(), 1 );
-        
-        distToPart1 = partons[0].delta_R( CaJets[0] );
-        distToPart2 = partons[1].delta_R( CaJets[0] );
-        partonIdx = 0;
-        if ( distToPart2 < distToPart1 )
-          partonIdx = 1;
-        deltaRCa->Fill ( radBin.c_str(), partons[partonIdx].delta_R( CaJets[0] ), 1 );
-        deltaECa->Fill ( radBin.c_str(), partons[partonIdx].E() - CaJets[0].E(), 1 );
-        
-        distToPart1 = partons[0].delta_R( SISJets[0] );
-        distToPart2 = partons[1].delta_R( SISJets[0] );
-        partonIdx = 0;
-        if ( distToPart2 < distToPart1 )
-          partonIdx = 1;
-        deltaRSIS->Fill ( radBin.c_str(), partons[partonIdx].delta_R( SISJets[0] ), 1 );
-        deltaESIS->Fill ( radBin.c_str(), partons[partonIdx].E() - SISJets[0].E(), 1 );
-      }
+      // the base radius full and charged jet multiplicities are
+      // filled inside the radius loop, from the same clusterings
+      
+      // ghosts and cell ordering, shared by all clusterings, then
+      // SISCone for all radii at once and the other jetfinders
+      // radius by radius. the histograms are filled per radius,
+      // in the callbacks above the loop
+      std::chrono::time_point<clock> eventStart = clock::now();
+      exporter.beginEvent( currentEvent, weight );
+      jetFinder.cluster( weight );
+      
+      groomer.endEvent();
+      equivalence.endEvent( area_spec );
+      exporter.endEvent();
+      double eventTime = std::chrono::duration<double, std::milli>( clock::now() - eventStart ).count();
+      eec.endEvent( eventTime );
+      trigger.eventDone( eventTime );
       
+      // stop early if all targets have converged
+      if ( eventDone() )
+        break;
     }
   } catch ( std::exception& e) {
     std::cerr << "Caught " << e.what() << std::endl;
     return -1;
   }
+  telemetry.stop();
+  exporter.finish();
+  if ( currentEvent == blockEnd )
+    work.complete( gDirectory );
+  snapshots.publish( currentEvent );
+#ifdef JETFIND_MPI
+  // the event loop alone, for the load balance of the ranks
+  double loopTime = std::chrono::duration<double>( clock::now() - loop_start ).count();
+#endif
+  
+  // normalize the last pT-hat bin
+  if ( usePythia )
+    weights.endBin( *pythia, currentEvent - binStartEvent );
+  weights.finish();
   std::cout<<"processed "<<currentEvent<<" events"<<std::endl;
+  trigger.report();
   
   // print out pythia statistics
-  pythia.stat();
+  if ( usePythia )
+    pythia->stat();
+  
+  // report the input throughput, the event loop should never
+  // be waiting on the reader
+  if ( useHepMC ) {
+    HepMCReaderStats input = hepmc.stats();
+    std::cout<<"HepMC input: "<<input.events<<" events, "<<input.megabytes<<" MB parsed in "<<input.parseSeconds<<" s ( "
+             <<( input.parseSeconds > 0 ? input.megabytes / input.parseSeconds : 0 )<<" MB/s ), event loop waited "
+             <<input.waitSeconds<<" s"<<std::endl;
+  }
+  hepmc.close();
+  
+#ifdef JETFIND_MPI
+  // sum the histograms onto rank 0, and measure how evenly
+  // the work was spread: efficiency = mean / max loop time
+  double reduceTime = reduceHistograms( gDirectory, mpiRank, mpiSize, weights.weighted() );
+  perf.reduce( mpiRank );
+  equivalence.reduce( mpiRank );
+  double maxLoopTime = 0, sumLoopTime = 0;
+  unsigned long rankEvents = currentEvent, totalEvents = 0;
+  MPI_Reduce( &loopTime, &maxLoopTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD );
+  MPI_Reduce( &loopTime, &sumLoopTime, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+  MPI_Reduce( &rankEvents, &totalEvents, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD );
+  if ( mpiRank != 0 ) {
+    MPI_Finalize();
+    return 0;
+  }
+  double efficiency = maxLoopTime > 0 ? sumLoopTime / mpiSize / maxLoopTime : 1;
+  std::cout<<"MPI: "<<mpiSize<<" ranks, "<<totalEvents<<" events, slowest rank "<<maxLoopTime<<" s, "
+           <<( maxLoopTime > 0 ? totalEvents / maxLoopTime : 0 )<<" events/s, scaling efficiency "<<efficiency
+           <<", reduction "<<reduceTime<<" s"<<std::endl;
+  TH1D* mpiScaling = new TH1D( "mpiscaling", "MPI Scaling", 6, -0.5, 5.5 );
+  const char* mpiLabels[] = { "ranks", "events", "loop_max_s", "loop_mean_s", "efficiency", "reduce_s" };
+  double mpiValues[] = { (double) mpiSize, (double) totalEvents, maxLoopTime, sumLoopTime / mpiSize, efficiency, reduceTime };
+  for ( int i = 0; i < 6; ++i ) {
+    mpiScaling->GetXaxis()->SetBinLabel( i+1, mpiLabels[i] );
+    mpiScaling->SetBinContent( i+1, mpiValues[i] );
+  }
+  currentEvent = totalEvents;
+#endif
   
   // write out to a root file all histograms
   TFile out( outFile.c_str(), "RECREATE" );
@@ -650,13 +1228,17 @@ int main( int argc, const char** argv ) {
   chargedE->Write();
   chargedEtaPhi->Write();
   
-  // // jet multiplicity
-  // nJetsAntiKtBaseAll->Write();
-  // nJetsKtBaseAll->Write();
-  // nJetsCaBaseAll->Write();
-  // nJetsAntiKtBaseCharged->Write();
-  // nJetsKtBaseCharged->Write();
-  // nJetsCaBaseCharged->Write();
+  // jet multiplicity at the base radius, full and charged
+  nJetsAntiKtBaseAll->Write();
+  nJetsKtBaseAll->Write();
+  nJetsCaBaseAll->Write();
+  nJetsAntiKtBaseCharged->Write();
+  nJetsKtBaseCharged->Write();
+  nJetsCaBaseCharged->Write();
+  for ( int i = 0; i < 3; ++i ) {
+    chargedFracBase[i]->Write();
+    chargedDRBase[i]->Write();
+  }
   
   // histograms for differing radii
   nJetsAntiKt->Write();
@@ -718,14 +1300,54 @@ int main( int argc, const char** argv ) {
   etaLeadSIS->Write();
   phiSIS->Write();
   phiLeadSIS->Write();
+  nStableSIS->Write();
+  eventTimeSIS->Write();
+  prepTime->Write();
+  
+  // leading jet energy correlators
+  eec.write();
+  
+  // jet shapes
+  shapes.write();
+  
+  // groomed leading jets
+  groomer.write();
+  matchStudy.write();
+  trigger.write();
+  startup.report();
+  startup.write();
+  fastLead.report();
+  fastLead.write();
+  perf.write();
+  equivalence.write();
+  exporter.report();
+  exporter.write();
+  
+  // clustering cost against input size, and the fitted scaling
+  scaling.write();
+  scaling.fit( std::cout );
+  
+  // sequential stopping decision
+  stopper.write( currentEvent, maxEvent );
+  
+  // cross section per pT-hat bin
+  if ( usePythia )
+    weights.write();
+  
+#ifdef JETFIND_MPI
+  mpiScaling->Write();
+#endif
   
   // close the output file
   out.Close();
   
   // stop timing and report
   double analysis_time = std::chrono::duration_cast<std::chrono::seconds>(clock::now() - analysis_start).count();
-  std::cout<<"Analysis of " << maxEvent <<" Pythia events took " << analysis_time << " seconds. Exiting" << std::endl;
+  std::cout<<"Analysis of " << currentEvent <<" "<<eventSource<<" events took " << analysis_time << " seconds. Exiting" << std::endl;
   
+#ifdef JETFIND_MPI
+  MPI_Finalize();
+#endif
   return 0;
 }
 
@@ -0,0 +1,327 @@
+// soft drop, trimming and filtering of the leading jets
+// Nick Elsey
+
+// grooming needs a Cambridge/Aachen tree of the jet. FastJet's
+// tools recluster the constituents, ghosts included, which would
+// add a clustering for every jetfinder and radius. instead:
+// - CA jets already are a CA tree. soft drop walks the hard branch
+//   of the jet's own history with has_parents(), and fastjet::Filter
+//   takes its CA subjets straight from that history
+// - for the other jetfinders the real constituents ( ghosts are
+//   dropped ) are copied into flat arrays and reclustered with a
+//   small nearest neighbour CA on them alone, a few dozen particles
+//   instead of thousands of inputs. the subjets for trimming and
+//   filtering are read off that clustering as it passes their radius
+// for every jetfinder and radius the leading jet fills
+// - <jetfinder>sdmass, <jetfinder>zg, <jetfinder>rg : soft drop with
+//   z > zcut ( dR / R )^beta. zg and rg only when a splitting passes
+// - <jetfinder>trimmass : subjets of radius trimRadius above
+//   trimFraction of the jet pt
+// - <jetfinder>filtmass : the filterN hardest subjets of filterRadius
+// and the total time per event goes into groomtime ( ms )
+
+#ifndef JETGROOMER_HH
+#define JETGROOMER_HH
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/Selector.hh"
+#include "fastjet/tools/Filter.hh"
+
+#include "TH1.h"
+#include "TH2.h"
+
+#include "histStorage.hh"
+
+struct GroomSettings {
+  double zcut;
+  double beta;
+  double trimRadius;
+  double trimFraction;
+  double filterRadius;
+  unsigned filterN;
+
+  GroomSettings() : zcut( 0.1 ), beta( 0.0 ), trimRadius( 0.2 ), trimFraction( 0.05 ),
+  filterRadius( 0.3 ), filterN( 3 ) { }
+};
+
+class JetGroomer {
+public:
+
+  // jets of jetfinder caIndex are groomed through their own history
+  JetGroomer( const std::vector<std::string>& jetfinders, const std::vector<std::string>& radiusLabels,
+              const GroomSettings& settings, unsigned caIndex ) :
+  settings_( settings ), caIndex_( caIndex ),
+  trimmer_( settings.trimRadius, fastjet::SelectorPtFractionMin( settings.trimFraction ) ),
+  filter_( settings.filterRadius, fastjet::SelectorNHardest( settings.filterN ) ), time_( 0 ) {
+    const char* names[nObservables] = { "sdmass", "zg", "rg", "trimmass", "filtmass" };
+    const char* titles[nObservables] = { "Soft Drop Mass", "Soft Drop z_{g}", "Soft Drop R_{g}", "Trimmed Mass", "Filtered Mass" };
+    const double upper[nObservables] = { 200, 0.5, 1.0, 200, 200 };
+    int nRadii = radiusLabels.size();
+    hists_.resize( jetfinders.size() );
+    for ( unsigned i = 0; i < jetfinders.size(); ++i ) {
+      for ( int k = 0; k < nObservables; ++k ) {
+        TH2* h = newRadiusHist( ( jetfinders[i] + names[k] ).c_str(), ( std::string( "Lead Jet " ) + titles[k] + " - " + jetfinders[i] ).c_str(),
+                            nRadii, -0.5, nRadii - 0.5, 100, 0, upper[k] );
+        for ( int j = 0; j < nRadii; ++j )
+          h->GetXaxis()->SetBinLabel( j+1, radiusLabels[j].c_str() );
+        hists_[i].push_back( h );
+      }
+    }
+    eventTime_ = new TH1D( "groomtime", "Grooming Time per Event", 500, 0, 50 );
+  }
+
+  // groom jet, the leading jet of jetfinder at radius R
+  void fill( unsigned jetfinder, unsigned radiusIdx, double R, const fastjet::PseudoJet& jet, double weight ) {
+    typedef std::chrono::high_resolution_clock clock;
+    std::chrono::time_point<clock> start = clock::now();
+
+    double values[nObservables];
+    bool passed;
+    if ( jetfinder == caIndex_ )
+      passed = groomHistory( jet, R, values );
+    else
+      passed = groomConstituents( jet, R, values );
+
+    for ( int k = 0; k < nObservables; ++k ) {
+      if ( !passed && ( k == zg || k == rg ) )
+        continue;
+      hists_[jetfinder][k]->Fill( radiusIdx, values[k], weight );
+    }
+    time_ += std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+  }
+
+  void endEvent() {
+    eventTime_->Fill( time_ );
+    time_ = 0;
+  }
+
+  void write() {
+    for ( unsigned i = 0; i < hists_.size(); ++i )
+      for ( unsigned k = 0; k < hists_[i].size(); ++k )
+        hists_[i][k]->Write();
+    eventTime_->Write();
+  }
+
+private:
+
+  enum Observable { sdmass = 0, zg, rg, trimmass, filtmass, nObservables };
+  // explicit ghosts have a pt of order 1e-100
+  static constexpr double ghostPt2 = 1e-40;
+
+  bool passes( double pt1, double pt2, double dr, double R, double& z ) const {
+    z = std::min( pt1, pt2 ) / ( pt1 + pt2 );
+    return z > settings_.zcut * std::pow( dr / R, settings_.beta );
+  }
+
+  // CA jets: soft drop along the history, subjets from the history
+  bool groomHistory( const fastjet::PseudoJet& jet, double R, double* values ) {
+    fastjet::PseudoJet current = jet, parent1, parent2;
+    bool passed = false;
+    values[zg] = 0;
+    values[rg] = 0;
+    while ( current.has_parents( parent1, parent2 ) ) {
+      double pt1 = parent1.pt(), pt2 = parent2.pt();
+      if ( pt1 + pt2 <= 0 )
+        break;
+      double dr = parent1.delta_R( parent2 );
+      double z;
+      if ( passes( pt1, pt2, dr, R, z ) ) {
+        values[zg] = z;
+        values[rg] = dr;
+        passed = true;
+        break;
+      }
+      current = pt1 > pt2 ? parent1 : parent2;
+    }
+    values[sdmass] = current.m();
+    values[trimmass] = trimmer_( jet ).m();
+    values[filtmass] = filter_( jet ).m();
+    return passed;
+  }
+
+  // other jets: CA on the real constituents only
+  bool groomConstituents( const fastjet::PseudoJet& jet, double R, double* values ) {
+    std::vector<fastjet::PseudoJet> constituents = jet.constituents();
+    nodes_.clear();
+    for ( unsigned i = 0; i < constituents.size(); ++i ) {
+      const fastjet::PseudoJet& c = constituents[i];
+      if ( c.pt2() > ghostPt2 )
+        nodes_.push_back( Node( c.px(), c.py(), c.pz(), c.E(), c.rap(), c.phi() ) );
+    }
+    for ( int k = 0; k < nObservables; ++k )
+      values[k] = 0;
+    if ( nodes_.empty() )
+      return false;
+
+    clusterCA();
+    int root = nodes_.size() - 1;
+    double jetPt = nodes_[root].pt();
+
+    // soft drop down the harder branch
+    int current = root;
+    bool passed = false;
+    while ( nodes_[current].left >= 0 ) {
+      const Node& a = nodes_[nodes_[current].left];
+      const Node& b = nodes_[nodes_[current].right];
+      double z;
+      if ( passes( a.pt(), b.pt(), nodes_[current].dr, R, z ) ) {
+        values[zg] = z;
+        values[rg] = nodes_[current].dr;
+        passed = true;
+        break;
+      }
+      current = a.pt() > b.pt() ? nodes_[current].left : nodes_[current].right;
+    }
+    values[sdmass] = nodes_[current].m();
+
+    // trimming: every subjet above the pt fraction
+    Node trimmed;
+    for ( unsigned i = 0; i < trimSubjets_.size(); ++i )
+      if ( nodes_[trimSubjets_[i]].pt() > settings_.trimFraction * jetPt )
+        trimmed.add( nodes_[trimSubjets_[i]] );
+    values[trimmass] = trimmed.m();
+
+    // filtering: the hardest subjets
+    std::vector<std::pair<double, int> > hardest;
+    for ( unsigned i = 0; i < filterSubjets_.size(); ++i )
+      hardest.push_back( std::make_pair( -nodes_[filterSubjets_[i]].pt(), filterSubjets_[i] ) );
+    std::sort( hardest.begin(), hardest.end() );
+    Node filtered;
+    for ( unsigned i = 0; i < hardest.size() && i < settings_.filterN; ++i )
+      filtered.add( nodes_[hardest[i].second] );
+    values[filtmass] = filtered.m();
+    return passed;
+  }
+
+  struct Node {
+    double px, py, pz, e, rap, phi;
+    int left, right;
+    double dr;     // distance between the two children
+    Node() : px( 0 ), py( 0 ), pz( 0 ), e( 0 ), rap( 0 ), phi( 0 ), left( -1 ), right( -1 ), dr( 0 ) { }
+    Node( double x, double y, double z, double t, double r, double p ) :
+    px( x ), py( y ), pz( z ), e( t ), rap( r ), phi( p ), left( -1 ), right( -1 ), dr( 0 ) { }
+    double pt() const { return std::sqrt( px * px + py * py ); }
+    double m() const { return std::sqrt( std::max( e * e - px * px - py * py - pz * pz, 0.0 ) ); }
+    void add( const Node& n ) { px += n.px; py += n.py; pz += n.pz; e += n.e; }
+  };
+
+  double distance2( int a, int b ) const {
+    double dy = nodes_[a].rap - nodes_[b].rap;
+    double dphi = std::fabs( nodes_[a].phi - nodes_[b].phi );
+    dphi = std::min( dphi, 2.0 * M_PI - dphi );
+    return dy * dy + dphi * dphi;
+  }
+
+  // nearest active neighbour of node a, in nn_ / nnDist_
+  void findNeighbour( int a ) {
+    nn_[a] = -1;
+    nnDist_[a] = 1e300;
+    for ( unsigned i = 0; i < active_.size(); ++i ) {
+      int b = active_[i];
+      if ( b == a )
+        continue;
+      double d = distance2( a, b );
+      if ( d < nnDist_[a] ) {
+        nnDist_[a] = d;
+        nn_[a] = b;
+      }
+    }
+  }
+
+  // E-scheme CA of the leaves in nodes_, merged nodes are appended
+  // so the root ends up last. the active nodes are saved as the
+  // subjets the first time the merging distance passes each radius
+  void clusterCA() {
+    unsigned n = nodes_.size();
+    nodes_.reserve( 2 * n );
+    nn_.assign( 2 * n, -1 );
+    nnDist_.assign( 2 * n, 1e300 );
+    active_.clear();
+    for ( unsigned i = 0; i < n; ++i )
+      active_.push_back( i );
+    for ( unsigned i = 0; i < n; ++i )
+      findNeighbour( i );
+
+    double trim2 = settings_.trimRadius * settings_.trimRadius;
+    double filter2 = settings_.filterRadius * settings_.filterRadius;
+    bool haveTrim = false, haveFilter = false;
+    while ( active_.size() > 1 ) {
+      int a = active_[0];
+      for ( unsigned i = 1; i < active_.size(); ++i )
+        if ( nnDist_[active_[i]] < nnDist_[a] )
+          a = active_[i];
+      int b = nn_[a];
+      double d2 = nnDist_[a];
+      if ( !haveTrim && d2 > trim2 ) {
+        trimSubjets_ = active_;
+        haveTrim = true;
+      }
+      if ( !haveFilter && d2 > filter2 ) {
+        filterSubjets_ = active_;
+        haveFilter = true;
+      }
+
+      Node merged = nodes_[a];
+      merged.add( nodes_[b] );
+      merged.rap = 0.5 * std::log( ( merged.e + merged.pz ) / std::max( merged.e - merged.pz, 1e-300 ) );
+      merged.phi = std::atan2( merged.py, merged.px );
+      if ( merged.phi < 0 )
+        merged.phi += 2.0 * M_PI;
+      merged.left = a;
+      merged.right = b;
+      merged.dr = std::sqrt( d2 );
+      int c = nodes_.size();
+      nodes_.push_back( merged );
+
+      for ( unsigned i = 0; i < active_.size(); ) {
+        if ( active_[i] == a || active_[i] == b ) {
+          active_[i] = active_.back();
+          active_.pop_back();
+        }
+        else
+          ++i;
+      }
+      active_.push_back( c );
+      findNeighbour( c );
+      for ( unsigned i = 0; i + 1 < active_.size(); ++i ) {
+        int k = active_[i];
+        if ( nn_[k] == a || nn_[k] == b )
+          findNeighbour( k );
+        else {
+          double d = distance2( k, c );
+          if ( d < nnDist_[k] ) {
+            nnDist_[k] = d;
+            nn_[k] = c;
+          }
+        }
+      }
+    }
+    if ( !haveTrim )
+      trimSubjets_.assign( 1, nodes_.size() - 1 );
+    if ( !haveFilter )
+      filterSubjets_.assign( 1, nodes_.size() - 1 );
+  }
+
+  GroomSettings settings_;
+  unsigned caIndex_;
+  fastjet::Filter trimmer_;
+  fastjet::Filter filter_;
+  std::vector<std::vector<TH2*> > hists_;
+  TH1D* eventTime_;
+  double time_;
+
+  std::vector<Node> nodes_;
+  std::vector<int> active_;
+  std::vector<int> nn_;
+  std::vector<double> nnDist_;
+  std::vector<int> trimSubjets_;
+  std::vector<int> filterSubjets_;
+};
+
+#endif
@@ -0,0 +1,135 @@
+// jet matching to partons, across jetfinders and across radii
+// Nick Elsey
+
+// the deltaR / deltaE histograms only compare the leading jet
+// with the two partons. here every jet above ptMin is matched,
+// one to one and closest pairs first ( JetGrid::match ):
+// - to the partons, within the jet radius:
+//   <jetfinder>partonresponse ( pt jet / pt parton ) and
+//   <jetfinder>partonmatchdr
+// - to the jets of the reference jetfinder ( the first one,
+//   anti-kt ) at the same radius: <jetfinder>algmatchfrac, the
+//   fraction of reference jets with a match, and
+//   <jetfinder>algptratio, pt / pt reference
+// - to its own jets at the previous radius, within that smaller
+//   radius: <jetfinder>radmatchfrac and <jetfinder>radptratio,
+//   pt( R ) / pt( R - deltaR )
+// each jet set is indexed once per configuration, and the grid
+// of the previous radius is kept for the next one
+
+#ifndef JETMATCHSTUDY_HH
+#define JETMATCHSTUDY_HH
+
+#include <vector>
+#include <string>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "TH2.h"
+
+#include "jetMatching.hh"
+#include "histStorage.hh"
+
+class JetMatchStudy {
+public:
+
+  JetMatchStudy( const std::vector<std::string>& jetfinders, const std::vector<std::string>& radiusLabels, double ptMin ) :
+  ptMin_( ptMin ), jets_( jetfinders.size() ), previous_( jetfinders.size() ) {
+    const char* names[nHists] = { "partonresponse", "partonmatchdr", "algmatchfrac", "algptratio", "radmatchfrac", "radptratio" };
+    const char* titles[nHists] = { "Jet / Parton Pt", "#Delta R Jet - Parton", "Fraction of Anti-Kt Jets Matched",
+                                   "Jet / Anti-Kt Jet Pt", "Fraction of Jets Matched at the Previous Radius",
+                                   "Jet Pt / Jet Pt at the Previous Radius" };
+    const double upper[nHists] = { 2.0, 1.0, 1.1, 2.0, 1.1, 2.0 };
+    int nRadii = radiusLabels.size();
+    hists_.resize( jetfinders.size() );
+    for ( unsigned i = 0; i < jetfinders.size(); ++i ) {
+      grids_.push_back( JetGrid( 1.0 ) );
+      previousGrids_.push_back( JetGrid( 1.0 ) );
+      for ( int k = 0; k < nHists; ++k ) {
+        TH2* h = newRadiusHist( ( jetfinders[i] + names[k] ).c_str(), ( std::string( titles[k] ) + " - " + jetfinders[i] ).c_str(),
+                            nRadii, -0.5, nRadii - 0.5, 110, 0, upper[k] );
+        for ( int j = 0; j < nRadii; ++j )
+          h->GetXaxis()->SetBinLabel( j+1, radiusLabels[j].c_str() );
+        hists_[i].push_back( h );
+      }
+    }
+  }
+
+  // jets[k] are the jets of jetfinder k at radius R, radius index
+  // radiusIdx. radii have to come in increasing order
+  void fill( unsigned radiusIdx, double R, const std::vector<const std::vector<fastjet::PseudoJet>*>& jets,
+             const std::vector<fastjet::PseudoJet>& partons, double weight ) {
+    for ( unsigned k = 0; k < jets_.size(); ++k ) {
+      jets_[k].clear();
+      for ( unsigned j = 0; j < jets[k]->size(); ++j )
+        if ( ( *jets[k] )[j].pt() > ptMin_ )
+          jets_[k].push_back( ( *jets[k] )[j] );
+      grids_[k].build( jets_[k], R );
+    }
+
+    for ( unsigned k = 0; k < jets_.size(); ++k ) {
+      // partons to this jetfinder's jets
+      grids_[k].match( partons, matches_ );
+      for ( unsigned p = 0; p < partons.size(); ++p ) {
+        if ( matches_[p] < 0 )
+          continue;
+        const fastjet::PseudoJet& jet = jets_[k][matches_[p]];
+        hists_[k][partonResponse]->Fill( radiusIdx, jet.pt() / partons[p].pt(), weight );
+        hists_[k][partonMatchDR]->Fill( radiusIdx, jet.delta_R( partons[p] ), weight );
+      }
+
+      // reference jets to this jetfinder's jets
+      if ( k > 0 && !jets_[0].empty() ) {
+        grids_[k].match( jets_[0], matches_ );
+        unsigned matched = 0;
+        for ( unsigned j = 0; j < jets_[0].size(); ++j ) {
+          if ( matches_[j] < 0 )
+            continue;
+          matched++;
+          hists_[k][algPtRatio]->Fill( radiusIdx, jets_[k][matches_[j]].pt() / jets_[0][j].pt(), weight );
+        }
+        hists_[k][algMatchFrac]->Fill( radiusIdx, double( matched ) / jets_[0].size(), weight );
+      }
+
+      // jets at the previous radius to this radius' jets, within
+      // the previous radius, so the previous grid is the index
+      if ( radiusIdx > 0 && !jets_[k].empty() && !previous_[k].empty() ) {
+        previousGrids_[k].match( jets_[k], matches_ );
+        unsigned matched = 0;
+        for ( unsigned j = 0; j < jets_[k].size(); ++j ) {
+          if ( matches_[j] < 0 )
+            continue;
+          matched++;
+          hists_[k][radPtRatio]->Fill( radiusIdx, jets_[k][j].pt() / previous_[k][matches_[j]].pt(), weight );
+        }
+        hists_[k][radMatchFrac]->Fill( radiusIdx, double( matched ) / previous_[k].size(), weight );
+      }
+    }
+
+    // keep this radius for the next one
+    for ( unsigned k = 0; k < jets_.size(); ++k ) {
+      previous_[k].swap( jets_[k] );
+      previousGrids_[k].build( previous_[k], R );
+    }
+  }
+
+  void write() {
+    for ( unsigned i = 0; i < hists_.size(); ++i )
+      for ( unsigned k = 0; k < hists_[i].size(); ++k )
+        hists_[i][k]->Write();
+  }
+
+private:
+
+  enum Hist { partonResponse = 0, partonMatchDR, algMatchFrac, algPtRatio, radMatchFrac, radPtRatio, nHists };
+
+  double ptMin_;
+  std::vector<std::vector<TH2*> > hists_;
+  std::vector<std::vector<fastjet::PseudoJet> > jets_;
+  std::vector<std::vector<fastjet::PseudoJet> > previous_;
+  std::vector<JetGrid> grids_;
+  std::vector<JetGrid> previousGrids_;
+  std::vector<int> matches_;
+};
+
+#endif
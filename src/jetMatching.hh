@@ -0,0 +1,128 @@
+// spatially indexed jet matching
+// Nick Elsey
+
+// matching every jet of one set to the nearest jet of another
+// by comparing all pairs costs N x M delta R evaluations. JetGrid
+// instead puts the jets it is built from into rapidity - phi
+// cells at least maxDR wide, so a query only looks at the 3 x 3
+// cells around it ( phi wraps around ). the cells are a sorted
+// key list searched with equal_range, so building the grid for
+// a new event allocates nothing once the vectors have grown.
+// match() pairs jets one to one with the indexed jets, taking
+// the closest candidate pairs from the grid first
+
+#ifndef JETMATCHING_HH
+#define JETMATCHING_HH
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+
+class JetGrid {
+public:
+
+  explicit JetGrid( double maxDR ) : jets_( 0 ) {
+    setMaxDR( maxDR );
+  }
+
+  // index the jets, which have to outlive the queries
+  void build( const std::vector<fastjet::PseudoJet>& jets ) {
+    jets_ = &jets;
+    cells_.resize( jets.size() );
+    for ( unsigned i = 0; i < jets.size(); ++i )
+      cells_[i] = std::make_pair( key( rapCell( jets[i] ), phiCell( jets[i] ) ), i );
+    std::sort( cells_.begin(), cells_.end() );
+  }
+
+  // index the jets with a new matching radius
+  void build( const std::vector<fastjet::PseudoJet>& jets, double maxDR ) {
+    setMaxDR( maxDR );
+    build( jets );
+  }
+
+  // index of the nearest indexed jet within maxDR of jet, -1 if none
+  int nearest( const fastjet::PseudoJet& jet ) const {
+    int best = -1;
+    double bestDR2 = maxDR_ * maxDR_;
+    visit( jet, [&]( unsigned index, double dr2 ) {
+      if ( dr2 < bestDR2 ) {
+        bestDR2 = dr2;
+        best = index;
+      }
+    } );
+    return best;
+  }
+
+  // one to one matching of jets to the indexed jets within maxDR,
+  // closest pairs first. matches[i] is the indexed jet matched to
+  // jets[i], or -1
+  void match( const std::vector<fastjet::PseudoJet>& jets, std::vector<int>& matches ) {
+    candidates_.clear();
+    for ( unsigned i = 0; i < jets.size(); ++i )
+      visit( jets[i], [&]( unsigned index, double dr2 ) {
+        candidates_.push_back( std::make_pair( dr2, std::make_pair( i, index ) ) );
+      } );
+    std::sort( candidates_.begin(), candidates_.end() );
+
+    matches.assign( jets.size(), -1 );
+    taken_.assign( jets_->size(), false );
+    for ( unsigned c = 0; c < candidates_.size(); ++c ) {
+      unsigned i = candidates_[c].second.first;
+      unsigned j = candidates_[c].second.second;
+      if ( matches[i] >= 0 || taken_[j] )
+        continue;
+      matches[i] = j;
+      taken_[j] = true;
+    }
+  }
+
+  double maxDR() const { return maxDR_; }
+
+private:
+
+  void setMaxDR( double maxDR ) {
+    maxDR_ = maxDR;
+    nPhiCells_ = std::max( (long) std::floor( 2.0 * M_PI / maxDR_ ), 1L );
+    phiWidth_ = 2.0 * M_PI / nPhiCells_;
+  }
+
+  // call f( index, dR^2 ) for every indexed jet within maxDR of jet
+  template <class F>
+  void visit( const fastjet::PseudoJet& jet, F f ) const {
+    double maxDR2 = maxDR_ * maxDR_;
+    long rap = rapCell( jet );
+    long phi = phiCell( jet );
+    // with fewer than three phi cells the neighbours overlap
+    int nPhi = std::min( nPhiCells_, 3L );
+    for ( long dRap = -1; dRap <= 1; ++dRap ) {
+      for ( int dPhi = 0; dPhi < nPhi; ++dPhi ) {
+        long cell = key( rap + dRap, ( phi + dPhi - 1 + nPhiCells_ ) % nPhiCells_ );
+        std::vector<std::pair<long, unsigned> >::const_iterator it =
+          std::lower_bound( cells_.begin(), cells_.end(), std::make_pair( cell, 0u ) );
+        for ( ; it != cells_.end() && it->first == cell; ++it ) {
+          double dr2 = jet.squared_distance( ( *jets_ )[it->second] );
+          if ( dr2 < maxDR2 )
+            f( it->second, dr2 );
+        }
+      }
+    }
+  }
+
+  long rapCell( const fastjet::PseudoJet& jet ) const { return std::floor( jet.rap() / maxDR_ ); }
+  long phiCell( const fastjet::PseudoJet& jet ) const {
+    return std::min( (long) std::floor( jet.phi() / phiWidth_ ), nPhiCells_ - 1 );
+  }
+  long key( long rap, long phi ) const { return rap * nPhiCells_ + phi; }
+
+  double maxDR_;
+  long nPhiCells_;
+  double phiWidth_;
+  const std::vector<fastjet::PseudoJet>* jets_;
+  std::vector<std::pair<long, unsigned> > cells_;
+  std::vector<std::pair<double, std::pair<unsigned, unsigned> > > candidates_;
+  std::vector<bool> taken_;
+};
+
+#endif
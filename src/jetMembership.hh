@@ -0,0 +1,84 @@
+// which jet every input of a clustering ended up in
+// Nick Elsey
+
+// constituents() and particle_jet_indices() both walk the
+// clustering history up from every jet, once per jet. JetMembership
+// walks it once for the whole clustering instead: the history is
+// ordered so that every step comes after its parents, so going
+// through it backwards each step takes the jet of its child. the
+// inputs are then bucketed by jet, ghosts dropped, so jet k owns
+// the contiguous range [ begin( k ), end( k ) ) of inputs(). build
+// it once per clustering and share it between the constituent
+// counts, the jet shapes and the export
+
+#ifndef JETMEMBERSHIP_HH
+#define JETMEMBERSHIP_HH
+
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequence.hh"
+
+class JetMembership {
+public:
+
+  // explicit ghosts have a pt of order 1e-100
+  static constexpr double ghostPt2 = 1e-40;
+
+  // jets have to come from cs
+  void build( const fastjet::ClusterSequence& cs, const std::vector<fastjet::PseudoJet>& jets ) {
+    const std::vector<fastjet::ClusterSequence::history_element>& history = cs.history();
+    const std::vector<fastjet::PseudoJet>& all = cs.jets();
+    unsigned nInputs = cs.n_particles();
+
+    owner_.assign( history.size(), -1 );
+    for ( unsigned k = 0; k < jets.size(); ++k )
+      owner_[jets[k].cluster_hist_index()] = k;
+    for ( int h = history.size() - 1; h >= 0; --h ) {
+      int child = history[h].child;
+      if ( owner_[h] < 0 && child >= 0 && child < (int) history.size() )
+        owner_[h] = owner_[child];
+    }
+
+    size_.assign( jets.size(), 0 );
+    offsets_.assign( jets.size() + 1, 0 );
+    for ( unsigned i = 0; i < nInputs; ++i ) {
+      int k = owner_[i];
+      if ( k < 0 )
+        continue;
+      size_[k]++;
+      if ( all[history[i].jetp_index].pt2() > ghostPt2 )
+        offsets_[k+1]++;
+    }
+    for ( unsigned k = 0; k < jets.size(); ++k )
+      offsets_[k+1] += offsets_[k];
+
+    fill_.assign( offsets_.begin(), offsets_.end() - 1 );
+    inputs_.resize( offsets_.back() );
+    for ( unsigned i = 0; i < nInputs; ++i ) {
+      int k = owner_[i];
+      const fastjet::PseudoJet& p = all[history[i].jetp_index];
+      if ( k >= 0 && p.pt2() > ghostPt2 )
+        inputs_[fill_[k]++] = &p;
+    }
+  }
+
+  // constituents of jet k, ghosts included, as constituents().size()
+  unsigned size( unsigned k ) const { return size_[k]; }
+  // the real ( non ghost ) constituents of jet k
+  unsigned real( unsigned k ) const { return offsets_[k+1] - offsets_[k]; }
+  unsigned begin( unsigned k ) const { return offsets_[k]; }
+  unsigned end( unsigned k ) const { return offsets_[k+1]; }
+  // valid as long as the cluster sequence is
+  const std::vector<const fastjet::PseudoJet*>& inputs() const { return inputs_; }
+
+private:
+
+  std::vector<int> owner_;
+  std::vector<unsigned> size_;
+  std::vector<unsigned> offsets_;
+  std::vector<unsigned> fill_;
+  std::vector<const fastjet::PseudoJet*> inputs_;
+};
+
+#endif
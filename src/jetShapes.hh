@@ -0,0 +1,127 @@
+// jet shapes for every jetfinder and radius
+// Nick Elsey
+
+// fills, for the inclusive and leading jets of every clustering,
+// histograms of radius against
+// - <jetfinder>girth    : sum_i z_i dR_i
+// - <jetfinder>lambda2  : thrust-like angularity sum_i z_i ( dR_i / R )^2
+// - <jetfinder>ptd      : pt dispersion sqrt( sum_i pt_i^2 ) / sum_i pt_i
+// - <jetfinder>mass     : jet mass
+// with a <jetfinder>...lead version for the leading jet. z_i and
+// dR_i are the constituent pt fraction and distance to the jet axis.
+// the inputs of every jet come from the clustering's JetMembership
+// ( one pass over the history, see jetMembership.hh ), their pt /
+// rap / phi are gathered into flat arrays in jet order, and every
+// jet is then a contiguous range evaluated for all shapes in one
+// loop that the compiler vectorizes
+
+#ifndef JETSHAPES_HH
+#define JETSHAPES_HH
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "TH2.h"
+
+#include "histStorage.hh"
+#include "jetMembership.hh"
+
+class JetShapes {
+public:
+
+  JetShapes( const std::vector<std::string>& jetfinders, const std::vector<std::string>& radiusLabels ) {
+    const char* names[nShapes] = { "girth", "lambda2", "ptd", "mass" };
+    const char* titles[nShapes] = { "Jet Girth", "Jet #lambda_{2}", "Jet p_{T}D", "Jet Mass" };
+    const double upper[nShapes] = { 0.5, 1.0, 1.0, 200 };
+    int nRadii = radiusLabels.size();
+    hists_.resize( jetfinders.size() );
+    for ( unsigned i = 0; i < jetfinders.size(); ++i ) {
+      for ( int s = 0; s < nShapes; ++s ) {
+        for ( int lead = 0; lead < 2; ++lead ) {
+          std::string name = jetfinders[i] + names[s] + ( lead ? "lead" : "" );
+          std::string title = std::string( lead ? "Lead " : "" ) + titles[s] + " - " + jetfinders[i];
+          TH2* h = newRadiusHist( name.c_str(), title.c_str(), nRadii, -0.5, nRadii - 0.5, 100, 0, upper[s] );
+          for ( int j = 0; j < nRadii; ++j )
+            h->GetXaxis()->SetBinLabel( j+1, radiusLabels[j].c_str() );
+          hists_[i].push_back( h );
+        }
+      }
+    }
+  }
+
+  // shapes of jets, clustered with radius R, whose inputs are in
+  // members. jets[0] is the leading jet
+  void fill( unsigned jetfinder, unsigned radiusIdx, double R, const JetMembership& members,
+             const std::vector<fastjet::PseudoJet>& jets, double weight ) {
+    if ( jets.empty() )
+      return;
+    gather( members );
+
+    for ( unsigned k = 0; k < jets.size(); ++k ) {
+      double sumPt = 0, sumPt2 = 0, girth = 0, lambda2 = 0;
+      const double* pt = &pt_[0];
+      const double* rap = &rap_[0];
+      const double* phi = &phi_[0];
+      double jetRap = jets[k].rap();
+      double jetPhi = jets[k].phi();
+      for ( unsigned i = members.begin( k ); i < members.end( k ); ++i ) {
+        double dy = rap[i] - jetRap;
+        double dphi = std::fabs( phi[i] - jetPhi );
+        dphi = std::min( dphi, 2.0 * M_PI - dphi );
+        double dr2 = dy * dy + dphi * dphi;
+        sumPt += pt[i];
+        sumPt2 += pt[i] * pt[i];
+        girth += pt[i] * std::sqrt( dr2 );
+        lambda2 += pt[i] * dr2;
+      }
+      if ( sumPt <= 0 )
+        continue;
+      double values[nShapes] = { girth / sumPt, lambda2 / ( sumPt * R * R ), std::sqrt( sumPt2 ) / sumPt, jets[k].m() };
+      for ( int s = 0; s < nShapes; ++s ) {
+        hists_[jetfinder][2*s]->Fill( radiusIdx, values[s], weight );
+        if ( k == 0 )
+          hists_[jetfinder][2*s+1]->Fill( radiusIdx, values[s], weight );
+      }
+    }
+  }
+
+  void write() {
+    for ( unsigned i = 0; i < hists_.size(); ++i )
+      for ( unsigned j = 0; j < hists_[i].size(); ++j )
+        hists_[i][j]->Write();
+  }
+
+private:
+
+  static const int nShapes = 4;
+
+  // the real inputs of every jet, in jet order
+  void gather( const JetMembership& members ) {
+    const std::vector<const fastjet::PseudoJet*>& inputs = members.inputs();
+    pt_.resize( inputs.size() );
+    rap_.resize( inputs.size() );
+    phi_.resize( inputs.size() );
+    for ( unsigned i = 0; i < inputs.size(); ++i ) {
+      pt_[i] = inputs[i]->pt();
+      rap_[i] = inputs[i]->rap();
+      phi_[i] = inputs[i]->phi();
+    }
+    // keep the pointers in fill valid for a jet without real inputs
+    if ( pt_.empty() ) {
+      pt_.push_back( 0 );
+      rap_.push_back( 0 );
+      phi_.push_back( 0 );
+    }
+  }
+
+  std::vector<std::vector<TH2*> > hists_;
+  std::vector<double> pt_;
+  std::vector<double> rap_;
+  std::vector<double> phi_;
+};
+
+#endif
@@ -0,0 +1,133 @@
+// in-memory histogram reduction for the MPI build
+// Nick Elsey
+
+// every rank books the same histograms in the same order, so
+// the contents, errors and statistics of all of them can be
+// packed into one buffer and summed onto rank 0 with a single
+// MPI_Reduce ( which the MPI library runs as a tree ). rank 0
+// then writes one output file as usual.
+//
+// profiles ( clusterScaling's timevsn ) are packed raw: their own
+// array holds the sum of w y per bin, GetBinContent would be the
+// mean. the bin entries and the per bin sum of w^2 are reduced
+// with them, so the result is the same as merging the profiles
+
+#ifndef MPIREDUCE_HH
+#define MPIREDUCE_HH
+
+#ifdef JETFIND_MPI
+
+#include <vector>
+#include <string>
+
+#include <mpi.h>
+
+#include "TH1.h"
+#include "TProfile.h"
+#include "TProfile2D.h"
+#include "TList.h"
+#include "TArrayD.h"
+#include "TDirectory.h"
+
+// the profile parts that GetBinContent / GetSumw2 do not cover,
+// false for ordinary histograms
+struct ProfileParts {
+  TProfile* p1;
+  TProfile2D* p2;
+  explicit ProfileParts( TH1* h ) : p1( dynamic_cast<TProfile*>( h ) ), p2( dynamic_cast<TProfile2D*>( h ) ) { }
+  operator bool() const { return p1 || p2; }
+  TArrayD* sums() const { return p1 ? static_cast<TArrayD*>( p1 ) : static_cast<TArrayD*>( p2 ); }
+  TArrayD* binSumw2() const { return p1 ? p1->GetBinSumw2() : p2->GetBinSumw2(); }
+  double entries( int bin ) const { return p1 ? p1->GetBinEntries( bin ) : p2->GetBinEntries( bin ); }
+  void setEntries( int bin, double w ) const {
+    if ( p1 ) p1->SetBinEntries( bin, w );
+    else p2->SetBinEntries( bin, w );
+  }
+};
+
+// sum every histogram held in memory by dir onto rank 0
+// weighted histograms ( cross sections ) are averaged instead,
+// except for the timing histograms, which are always counts, and
+// the profiles, whose means are unchanged by averaging
+// returns the time spent in the reduction, in seconds
+inline double reduceHistograms( TDirectory* dir, int rank, int size, bool average ) {
+  double start = MPI_Wtime();
+
+  std::vector<TH1*> hists;
+  TList* list = dir->GetList();
+  for ( int i = 0; i < list->GetSize(); ++i ) {
+    TH1* h = dynamic_cast<TH1*>( list->At( i ) );
+    if ( h )
+      hists.push_back( h );
+  }
+
+  // per histogram: entries, 13 statistics, the bin contents
+  // and, if it has them, the sum of squared weights. profiles add
+  // the bin entries and the per bin sum of w^2
+  const int nStats = 13;
+  std::vector<double> buffer;
+  for ( unsigned i = 0; i < hists.size(); ++i ) {
+    TH1* h = hists[i];
+    buffer.push_back( h->GetEntries() );
+    double stats[nStats] = { 0 };
+    h->GetStats( stats );
+    buffer.insert( buffer.end(), stats, stats + nStats );
+    ProfileParts profile( h );
+    for ( int bin = 0; bin < h->GetNcells(); ++bin )
+      buffer.push_back( profile ? profile.sums()->GetArray()[bin] : h->GetBinContent( bin ) );
+    TArrayD* sumw2 = h->GetSumw2();
+    if ( sumw2 && sumw2->GetSize() )
+      buffer.insert( buffer.end(), sumw2->GetArray(), sumw2->GetArray() + sumw2->GetSize() );
+    if ( profile ) {
+      for ( int bin = 0; bin < h->GetNcells(); ++bin )
+        buffer.push_back( profile.entries( bin ) );
+      TArrayD* binSumw2 = profile.binSumw2();
+      if ( binSumw2 && binSumw2->GetSize() )
+        buffer.insert( buffer.end(), binSumw2->GetArray(), binSumw2->GetArray() + binSumw2->GetSize() );
+    }
+  }
+
+  std::vector<double> result( rank == 0 ? buffer.size() : 0 );
+  MPI_Reduce( &buffer[0], rank == 0 ? &result[0] : 0, buffer.size(), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+
+  if ( rank == 0 ) {
+    std::size_t pos = 0;
+    for ( unsigned i = 0; i < hists.size(); ++i ) {
+      TH1* h = hists[i];
+      bool timing = std::string( h->GetName() ).find( "time" ) != std::string::npos;
+      ProfileParts profile( h );
+      double scale = average && !timing && !profile ? 1.0 / size : 1.0;
+      double entries = result[pos++];
+      double stats[nStats];
+      for ( int j = 0; j < nStats; ++j )
+        stats[j] = result[pos++] * scale;
+      stats[1] *= scale; // sum of squared weights
+      for ( int bin = 0; bin < h->GetNcells(); ++bin ) {
+        if ( profile )
+          profile.sums()->GetArray()[bin] = result[pos++];
+        else
+          h->SetBinContent( bin, result[pos++] * scale );
+      }
+      TArrayD* sumw2 = h->GetSumw2();
+      if ( sumw2 && sumw2->GetSize() )
+        for ( int bin = 0; bin < sumw2->GetSize(); ++bin )
+          sumw2->GetArray()[bin] = result[pos++] * scale * scale;
+      if ( profile ) {
+        for ( int bin = 0; bin < h->GetNcells(); ++bin )
+          profile.setEntries( bin, result[pos++] );
+        TArrayD* binSumw2 = profile.binSumw2();
+        if ( binSumw2 && binSumw2->GetSize() )
+          for ( int bin = 0; bin < binSumw2->GetSize(); ++bin )
+            binSumw2->GetArray()[bin] = result[pos++];
+      }
+      h->PutStats( stats );
+      h->SetEntries( entries );
+    }
+  }
+
+  return MPI_Wtime() - start;
+}
+
+#endif
+
+#endif
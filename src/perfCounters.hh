@@ -0,0 +1,211 @@
+// hardware performance counters per analysis stage
+// Nick Elsey
+
+// the clustertime histograms say how long a stage takes, not why.
+// with perf_counters=1 the stages of the event loop ( generation,
+// conversion, preparation, SISCone and every anti-kt, kt and CA
+// clustering per radius ) are bracketed by begin() / end(), which
+// read one perf_event_open group of
+//   cycles, instructions, cache misses ( last level ), branch misses
+// on the calling thread, user space only. the differences are
+// summed per stage, and write() stores the totals together with
+// the IPC and the misses per input particle as perfcounters
+// ( stages x quantities ) and prints them. counters that can not
+// be opened ( perf_event_paranoid, virtual machines, not Linux )
+// are reported as -1, and without any counter begin() and end()
+// do nothing. SISCone threads beyond the calling one, and the
+// HepMC parsing thread, are not counted
+
+#ifndef PERFCOUNTERS_HH
+#define PERFCOUNTERS_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "TH2.h"
+
+#ifdef JETFIND_MPI
+#include <mpi.h>
+#endif
+
+class PerfCounters {
+public:
+
+  explicit PerfCounters( bool enable ) : leader_( -1 ), active_( false ) {
+    for ( int i = 0; i < nCounters; ++i )
+      slot_[i] = -1;
+    if ( enable )
+      open();
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for ( unsigned i = 0; i < fds_.size(); ++i )
+      close( fds_[i] );
+#endif
+  }
+
+  bool available() const { return leader_ >= 0; }
+
+  // register a stage, returns its index
+  unsigned addStage( const std::string& name ) {
+    names_.push_back( name );
+    sums_.resize( names_.size() * nSums, 0.0 );
+    return names_.size() - 1;
+  }
+
+  void begin() {
+    if ( !available() )
+      return;
+    active_ = read( start_ );
+  }
+
+  // attribute the counts since begin() to stage, which processed
+  // particles inputs
+  void end( unsigned stage, unsigned particles = 0 ) {
+    if ( !available() || !active_ )
+      return;
+    active_ = false;
+    double now[nCounters];
+    if ( !read( now ) )
+      return;
+    double* sums = &sums_[stage * nSums];
+    for ( int i = 0; i < nCounters; ++i )
+      sums[i] += now[i] - start_[i];
+    sums[calls] += 1;
+    sums[particleSum] += particles;
+  }
+
+  // particles known only after the stage, e.g. for generation
+  void addParticles( unsigned stage, unsigned particles ) {
+    if ( available() )
+      sums_[stage * nSums + particleSum] += particles;
+  }
+
+#ifdef JETFIND_MPI
+  // sum the stage totals onto rank 0
+  void reduce( int rank ) {
+    if ( sums_.empty() )
+      return;
+    std::vector<double> total( sums_.size() );
+    MPI_Reduce( &sums_[0], &total[0], sums_.size(), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+    if ( rank == 0 )
+      sums_ = total;
+  }
+#endif
+
+  // the totals and derived quantities as a histogram, and a table
+  void write() {
+    if ( !available() ) {
+      std::cout<<"perf counters: not available"<<std::endl;
+      return;
+    }
+    const char* labels[nQuantities] = { "cycles", "instructions", "cachemisses", "branchmisses", "calls", "particles",
+                                        "ipc", "cachemissesperparticle", "branchmissesperparticle" };
+    TH2D* h = new TH2D( "perfcounters", "Hardware Counters per Stage", names_.size(), -0.5, names_.size() - 0.5,
+                        nQuantities, -0.5, nQuantities - 0.5 );
+    for ( int q = 0; q < nQuantities; ++q )
+      h->GetYaxis()->SetBinLabel( q+1, labels[q] );
+
+    std::cout<<"perf counters:"<<std::endl;
+    std::cout<<std::setw( 16 )<<"stage"<<std::setw( 12 )<<"calls"<<std::setw( 10 )<<"IPC"
+             <<std::setw( 16 )<<"cache miss/part"<<std::setw( 16 )<<"branch miss/part"<<std::endl;
+    for ( unsigned s = 0; s < names_.size(); ++s ) {
+      h->GetXaxis()->SetBinLabel( s+1, names_[s].c_str() );
+      const double* sums = &sums_[s * nSums];
+      double values[nQuantities];
+      for ( int i = 0; i < nCounters; ++i )
+        values[i] = slot_[i] >= 0 ? sums[i] : -1;
+      values[calls] = sums[calls];
+      values[particleSum] = sums[particleSum];
+      values[ipc] = slot_[cycles] >= 0 && slot_[instructions] >= 0 && sums[cycles] > 0 ? sums[instructions] / sums[cycles] : -1;
+      values[cachePerParticle] = slot_[cacheMisses] >= 0 && sums[particleSum] > 0 ? sums[cacheMisses] / sums[particleSum] : -1;
+      values[branchPerParticle] = slot_[branchMisses] >= 0 && sums[particleSum] > 0 ? sums[branchMisses] / sums[particleSum] : -1;
+      for ( int q = 0; q < nQuantities; ++q )
+        h->SetBinContent( s+1, q+1, values[q] );
+      if ( sums[calls] > 0 )
+        std::cout<<std::setw( 16 )<<names_[s]<<std::setw( 12 )<<sums[calls]<<std::setw( 10 )<<values[ipc]
+                 <<std::setw( 16 )<<values[cachePerParticle]<<std::setw( 16 )<<values[branchPerParticle]<<std::endl;
+    }
+    h->Write();
+  }
+
+private:
+
+  enum Counter { cycles = 0, instructions, cacheMisses, branchMisses, nCounters };
+  enum Sum { calls = nCounters, particleSum, nSums };
+  enum Quantity { ipc = nSums, cachePerParticle, branchPerParticle, nQuantities };
+
+  void open() {
+#ifdef __linux__
+    const unsigned long long configs[nCounters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+    for ( int i = 0; i < nCounters; ++i ) {
+      struct perf_event_attr attr;
+      std::memset( &attr, 0, sizeof( attr ) );
+      attr.size = sizeof( attr );
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = leader_ < 0 ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      int fd = syscall( __NR_perf_event_open, &attr, 0, -1, leader_, 0 );
+      if ( fd < 0 )
+        continue;
+      if ( leader_ < 0 )
+        leader_ = fd;
+      slot_[i] = fds_.size();
+      fds_.push_back( fd );
+    }
+    if ( !available() ) {
+      std::cerr<<"Warning: perf_event_open failed, no hardware counters ( check /proc/sys/kernel/perf_event_paranoid )"<<std::endl;
+      return;
+    }
+    const char* names[nCounters] = { "cycles", "instructions", "cache misses", "branch misses" };
+    for ( int i = 0; i < nCounters; ++i )
+      if ( slot_[i] < 0 )
+        std::cerr<<"Warning: hardware counter for "<<names[i]<<" is not available"<<std::endl;
+    ioctl( leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+#else
+    std::cerr<<"Warning: hardware counters need Linux"<<std::endl;
+#endif
+  }
+
+  // current counter values, scaled up if the group was multiplexed
+  bool read( double* values ) {
+#ifdef __linux__
+    unsigned long long buffer[3 + nCounters];
+    ssize_t bytes = ::read( leader_, buffer, sizeof( buffer ) );
+    if ( bytes < (ssize_t) ( 3 * sizeof( unsigned long long ) ) )
+      return false;
+    double scale = buffer[2] > 0 && buffer[2] < buffer[1] ? double( buffer[1] ) / buffer[2] : 1.0;
+    for ( int i = 0; i < nCounters; ++i )
+      values[i] = slot_[i] >= 0 && (unsigned long long) slot_[i] < buffer[0] ? buffer[3 + slot_[i]] * scale : 0.0;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  int leader_;
+  int slot_[nCounters];
+  std::vector<int> fds_;
+  bool active_;
+  double start_[nCounters];
+  std::vector<std::string> names_;
+  std::vector<double> sums_;
+};
+
+#endif
@@ -0,0 +1,181 @@
+// pT-hat binned and biased generation for jetFindAnalysis
+// Nick Elsey
+
+// three generation modes:
+//   unbiased : a single sample above pTHatMin, every event has
+//              weight 1 and histograms are plain counts ( default )
+//   bias     : PhaseSpace:bias2Selection oversamples high pT-hat,
+//              each event carries Pythia's compensating weight
+//   bins     : the events are split evenly over a set of pT-hat
+//              bins, Pythia is re-initialized for each bin
+// in the weighted modes each bin is normalized to its generated
+// cross section when it is finished, sigmaGen / sum of weights, so
+// the final histograms are differential cross sections in mb.
+// timing histograms ( "time" in the name ) are left as counts
+
+#ifndef PTHATWEIGHTS_HH
+#define PTHATWEIGHTS_HH
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+
+#include "TH1.h"
+#include "TList.h"
+#include "TDirectory.h"
+
+#include "Pythia8/Pythia.h"
+
+class PtHatWeights {
+public:
+
+  enum Mode { unbiased, bias, bins };
+
+  // edges is a comma separated list of pT-hat bin edges, the last
+  // edge may be -1 for an open bin. biasPow is the power of
+  // pT-hat used by bias2Selection
+  PtHatWeights( const std::string& mode, double pTHatMin, const std::string& edges, double biasPow ) :
+  mode_( unbiased ), biasPow_( biasPow ), currentBin_( 0 ), sumWeights_( 0 ) {
+    if ( mode == "bias" )
+      mode_ = bias;
+    else if ( mode == "bins" )
+      mode_ = bins;
+    else if ( mode != "unbiased" )
+      std::cerr<<"Warning: unknown gen_mode "<<mode<<", using unbiased"<<std::endl;
+
+    if ( mode_ == bins ) {
+      std::istringstream stm( edges );
+      std::string edge;
+      while ( std::getline( stm, edge, ',' ) )
+        edges_.push_back( atof( edge.c_str() ) );
+    }
+    if ( edges_.size() < 2 ) {
+      if ( mode_ == bins )
+        std::cerr<<"Warning: gen_pthatbins needs at least two edges, using a single bin"<<std::endl;
+      edges_.clear();
+      edges_.push_back( pTHatMin );
+      edges_.push_back( -1 );
+    }
+    sigma_.assign( nBins(), 0 );
+    events_.assign( nBins(), 0 );
+  }
+
+  Mode mode() const { return mode_; }
+  bool weighted() const { return mode_ != unbiased; }
+  unsigned nBins() const { return edges_.size() - 1; }
+  unsigned currentBin() const { return currentBin_; }
+
+  // number of events to generate in bin i, for total events
+  unsigned binEnd( unsigned i, unsigned total ) const {
+    return (unsigned long long) total * ( i + 1 ) / nBins();
+  }
+
+  // apply the settings of bin i to pythia and (re)initialize it
+  bool initBin( Pythia8::Pythia& pythia, unsigned i ) {
+    currentBin_ = i;
+    sumWeights_ = 0;
+    pythia.readString( "PhaseSpace:pTHatMin = " + toString( edges_[i] ) );
+    pythia.readString( "PhaseSpace:pTHatMax = " + toString( edges_[i+1] ) );
+    if ( mode_ == bias ) {
+      pythia.readString( "PhaseSpace:bias2Selection = on" );
+      pythia.readString( "PhaseSpace:bias2SelectionPow = " + toString( biasPow_ ) );
+      pythia.readString( "PhaseSpace:bias2SelectionRef = " + toString( edges_[i] ) );
+    }
+    if ( nBins() > 1 )
+      std::cout<<"pT-hat bin "<<i<<": "<<edges_[i]<<" - "<<edges_[i+1]<<std::endl;
+    return pythia.init();
+  }
+
+  // weight of the current event, to be used in every histogram fill
+  double eventWeight( const Pythia8::Pythia& pythia ) {
+    double w = mode_ == bias ? pythia.info.weight() : 1.0;
+    sumWeights_ += w;
+    return w;
+  }
+
+  // collect every histogram currently held in memory by dir
+  // should be called after all histograms are booked
+  void collect( TDirectory* dir ) {
+    if ( !weighted() )
+      return;
+    TList* list = dir->GetList();
+    for ( int i = 0; i < list->GetSize(); ++i ) {
+      TH1* h = dynamic_cast<TH1*>( list->At( i ) );
+      if ( h && std::string( h->GetName() ).find( "time" ) == std::string::npos )
+        hists_.push_back( h );
+    }
+    // clone only after the loop, Clone() adds to the directory list
+    for ( unsigned i = 0; i < hists_.size(); ++i ) {
+      TH1* h = hists_[i];
+      TH1* total = (TH1*) h->Clone( ( std::string( h->GetName() ) + "_xsec" ).c_str() );
+      total->SetDirectory( 0 );
+      total->Reset();
+      totals_.push_back( total );
+    }
+  }
+
+  // normalize the finished bin to its cross section and move it
+  // into the running totals
+  void endBin( const Pythia8::Pythia& pythia, unsigned events ) {
+    sigma_[currentBin_] = pythia.info.sigmaGen();
+    events_[currentBin_] = events;
+    if ( !weighted() )
+      return;
+    double scale = sumWeights_ > 0 ? sigma_[currentBin_] / sumWeights_ : 0;
+    for ( unsigned i = 0; i < hists_.size(); ++i ) {
+      totals_[i]->Add( hists_[i], scale );
+      hists_[i]->Reset();
+    }
+    sumWeights_ = 0;
+  }
+
+  // copy the normalized totals back, so the booked histograms can
+  // be written as usual
+  void finish() {
+    for ( unsigned i = 0; i < hists_.size(); ++i ) {
+      hists_[i]->Reset();
+      hists_[i]->Add( totals_[i] );
+      delete totals_[i];
+    }
+    hists_.clear();
+    totals_.clear();
+  }
+
+  // summary histograms "pthatbins" ( cross section per bin ) and
+  // "pthatbinevents", written into the current directory
+  void write() const {
+    TH1D* summary = new TH1D( "pthatbins", "Generated Cross Section per pT-hat Bin", nBins(), -0.5, nBins() - 0.5 );
+    TH1D* count = new TH1D( "pthatbinevents", "Events per pT-hat Bin", nBins(), -0.5, nBins() - 0.5 );
+    for ( unsigned i = 0; i < nBins(); ++i ) {
+      std::string label = toString( edges_[i] ) + "-" + ( edges_[i+1] < 0 ? std::string( "inf" ) : toString( edges_[i+1] ) );
+      summary->GetXaxis()->SetBinLabel( i+1, label.c_str() );
+      count->GetXaxis()->SetBinLabel( i+1, label.c_str() );
+      summary->SetBinContent( i+1, sigma_[i] );
+      count->SetBinContent( i+1, events_[i] );
+    }
+    summary->Write();
+    count->Write();
+  }
+
+private:
+
+  static std::string toString( double x ) {
+    std::ostringstream stm;
+    stm << x;
+    return stm.str();
+  }
+
+  Mode mode_;
+  double biasPow_;
+  std::vector<double> edges_;
+  std::vector<double> sigma_;
+  std::vector<unsigned> events_;
+  unsigned currentBin_;
+  double sumWeights_;
+  std::vector<TH1*> hists_;
+  std::vector<TH1*> totals_;
+};
+
+#endif
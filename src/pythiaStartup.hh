@@ -0,0 +1,194 @@
+// pythia construction, settings cache and startup timing
+// Nick Elsey
+
+// constructing Pythia parses the whole settings and particle data
+// xml ( a few hundred files under xmldoc ), init() then sets up the
+// processes. for short jobs and campaigns of many shards that is a
+// visible part of the run. PythiaStartup
+// - builds pythia from the xml directory given on the command line.
+//   if it has no Index.xml it falls back to pythia's own default
+//   ( PYTHIA8DATA ), which is what every job used before
+// - with pythia_cache=<prefix>, writes the parsed default settings
+//   and particle data to settings.xml and particles.xml once, and
+//   later jobs construct pythia from those two streams instead of
+//   the xml directory. the cache is a directory <prefix>.<hash>,
+//   named after the key ( the pythia version and the xml directory
+//   it was made from ), which it also holds in a key file. all
+//   three files are written into a temporary directory that is
+//   renamed in one step, so shards starting together see either
+//   the whole cache of their key or none, and never mix files of
+//   different writers. if another shard got there first its cache
+//   is kept. this needs pythia 8.3, older versions always read the
+//   xml directory
+// - times the construction, init() and the first event, and
+//   reports the time to the first event from the start of the job.
+//   those are stored as startuptime ( not scaled or averaged )
+
+#ifndef PYTHIASTARTUP_HH
+#define PYTHIASTARTUP_HH
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Pythia8/Pythia.h"
+
+#include "TH1.h"
+
+class PythiaStartup {
+public:
+
+  typedef std::chrono::high_resolution_clock clock;
+
+  PythiaStartup( const std::string& xmldir, const std::string& cache, std::chrono::time_point<clock> jobStart ) :
+  xmldir_( xmldir ), cache_( cache ), jobStart_( jobStart ), fromCache_( false ),
+  constructTime_( 0 ), initTime_( 0 ), firstEventTime_( -1 ), initStart_( clock::now() ) {
+    std::ifstream index( ( xmldir_ + "/Index.xml" ).c_str() );
+    if ( !index ) {
+      std::cerr<<"Warning: no Index.xml in "<<xmldir_<<", pythia uses its default xml directory"<<std::endl;
+      xmldir_.clear();
+    }
+  }
+
+  // a new pythia, from the cache when there is a valid one
+  Pythia8::Pythia* create() {
+    std::chrono::time_point<clock> start = clock::now();
+    Pythia8::Pythia* pythia = 0;
+#if defined( PYTHIA_VERSION_INTEGER ) && PYTHIA_VERSION_INTEGER >= 8300
+    if ( !cache_.empty() && readKey() == key() ) {
+      std::ifstream settings( ( cacheDir() + "/settings.xml" ).c_str() );
+      std::ifstream particles( ( cacheDir() + "/particles.xml" ).c_str() );
+      if ( settings && particles ) {
+        pythia = new Pythia8::Pythia( settings, particles, false );
+        fromCache_ = true;
+        cacheUsed_ = cacheDir();
+      }
+    }
+#else
+    if ( !cache_.empty() )
+      std::cerr<<"Warning: pythia_cache needs pythia 8.3, reading the xml directory"<<std::endl;
+#endif
+    if ( !pythia ) {
+      pythia = xmldir_.empty() ? new Pythia8::Pythia() : new Pythia8::Pythia( xmldir_ );
+#if defined( PYTHIA_VERSION_INTEGER ) && PYTHIA_VERSION_INTEGER >= 8300
+      if ( !cache_.empty() )
+        writeCache( *pythia );
+#endif
+    }
+    constructTime_ = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+    return pythia;
+  }
+
+  // bracket pythia.init(), or the init of the first pT-hat bin
+  void initStart() { initStart_ = clock::now(); }
+  void initDone() { initTime_ += std::chrono::duration<double, std::milli>( clock::now() - initStart_ ).count(); }
+
+  // the first event is through the event loop
+  void firstEvent() {
+    if ( firstEventTime_ < 0 )
+      firstEventTime_ = std::chrono::duration<double, std::milli>( clock::now() - jobStart_ ).count();
+  }
+
+  void report() const {
+    std::cout<<"startup: pythia constructed in "<<constructTime_<<" ms from "
+             <<( fromCache_ ? cacheUsed_ : xmldir_.empty() ? std::string( "the default xml directory" ) : xmldir_ )
+             <<", init "<<initTime_<<" ms, first event "<<firstEventTime_<<" ms after the start"<<std::endl;
+  }
+
+  void write() const {
+    TH1D* h = new TH1D( "startuptime", "Startup Time [ms]", 3, -0.5, 2.5 );
+    const char* labels[3] = { "construct", "init", "firstevent" };
+    const double values[3] = { constructTime_, initTime_, firstEventTime_ };
+    for ( int i = 0; i < 3; ++i ) {
+      h->GetXaxis()->SetBinLabel( i+1, labels[i] );
+      h->SetBinContent( i+1, values[i] );
+    }
+    h->Write();
+  }
+
+private:
+
+  std::string key() const {
+    std::ostringstream out;
+#ifdef PYTHIA_VERSION_INTEGER
+    out<<PYTHIA_VERSION_INTEGER;
+#endif
+    out<<" "<<( xmldir_.empty() ? "default" : xmldir_ );
+    return out.str();
+  }
+
+  // the cache directory of this key, FNV-1a so that every build
+  // names it the same
+  std::string cacheDir() const {
+    std::string k = key();
+    uint64_t hash = 14695981039346656037ULL;
+    for ( unsigned i = 0; i < k.size(); ++i ) {
+      hash ^= (unsigned char) k[i];
+      hash *= 1099511628211ULL;
+    }
+    std::ostringstream out;
+    out<<cache_<<"."<<std::hex<<hash;
+    return out.str();
+  }
+
+  std::string readKey() const {
+    std::ifstream in( ( cacheDir() + "/key" ).c_str() );
+    std::string line;
+    std::getline( in, line );
+    return line;
+  }
+
+#if defined( PYTHIA_VERSION_INTEGER ) && PYTHIA_VERSION_INTEGER >= 8300
+  // everything goes into a private directory first, which then
+  // becomes the cache in one rename
+  void writeCache( Pythia8::Pythia& pythia ) {
+    std::ostringstream tmp;
+    tmp<<cache_<<".tmp"<<getpid();
+    std::string dir = tmp.str();
+    std::string target = cacheDir();
+    if ( mkdir( dir.c_str(), 0755 ) != 0 ) {
+      std::cerr<<"Warning: could not write the pythia cache "<<target<<std::endl;
+      return;
+    }
+    {
+      std::ofstream out( ( dir + "/settings.xml" ).c_str() );
+      pythia.settings.writeFileXML( out );
+    }
+    pythia.particleData.listXML( dir + "/particles.xml" );
+    {
+      std::ofstream out( ( dir + "/key" ).c_str() );
+      out<<key()<<std::endl;
+    }
+    if ( std::rename( dir.c_str(), target.c_str() ) == 0 ) {
+      std::cout<<"startup: wrote the pythia cache "<<target<<std::endl;
+      return;
+    }
+    // another shard made it meanwhile, or it can not be written
+    if ( readKey() != key() )
+      std::cerr<<"Warning: could not write the pythia cache "<<target<<std::endl;
+    std::remove( ( dir + "/settings.xml" ).c_str() );
+    std::remove( ( dir + "/particles.xml" ).c_str() );
+    std::remove( ( dir + "/key" ).c_str() );
+    rmdir( dir.c_str() );
+  }
+#endif
+
+  std::string xmldir_;
+  std::string cache_;
+  std::string cacheUsed_;
+  std::chrono::time_point<clock> jobStart_;
+  bool fromCache_;
+  double constructTime_;
+  double initTime_;
+  double firstEventTime_;
+  std::chrono::time_point<clock> initStart_;
+};
+
+#endif
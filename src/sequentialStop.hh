@@ -0,0 +1,152 @@
+// sequential stopping for jetFindAnalysis
+// Nick Elsey
+
+// instead of a fixed 10^exponent events, the event loop
+// can run until the mean of a set of target observables is
+// known to a given relative precision, for every radius.
+// targets are radius histograms ( TH2, radius on x ), named
+// either in full ( "antiktdeltaE" ) or by observable only
+// ( "deltaE" ), which selects it for all four jetfinders.
+// the precision of a radius bin is the error on the mean
+// divided by |mean|, computed directly from the bin contents
+// so that no projections need to be made while running
+
+#ifndef SEQUENTIALSTOP_HH
+#define SEQUENTIALSTOP_HH
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <limits>
+
+#include "TH2.h"
+#include "TH1.h"
+#include "TDirectory.h"
+#include "TNamed.h"
+
+class SequentialStop {
+public:
+
+  // targets is a comma separated list of histogram or observable names
+  SequentialStop( const std::string& targets, double precision, unsigned checkInterval ) :
+  precision_( precision ), checkInterval_( checkInterval ? checkInterval : 1 ), converged_( false ),
+  lastCheck_( 0 ) {
+    const char* jetfinders[] = { "antikt", "kt", "ca", "sis" };
+    std::istringstream stm( targets );
+    std::string name;
+    while ( std::getline( stm, name, ',' ) ) {
+      if ( name.empty() )
+        continue;
+      if ( addTarget( name ) )
+        continue;
+      bool found = false;
+      for ( int i = 0; i < 4; ++i )
+        found |= addTarget( jetfinders[i] + name );
+      if ( !found )
+        std::cerr<<"Warning: sequential stopping target "<<name<<" does not match any histogram"<<std::endl;
+    }
+  }
+
+  bool active() const { return !targets_.empty(); }
+
+  // returns true once every target is at the requested precision
+  // the check itself only runs every checkInterval events
+  bool done( unsigned currentEvent ) {
+    if ( !active() || currentEvent - lastCheck_ < checkInterval_ )
+      return false;
+    lastCheck_ = currentEvent;
+    converged_ = true;
+    for ( unsigned i = 0; i < targets_.size(); ++i ) {
+      update( targets_[i] );
+      if ( !( targets_[i].achieved <= precision_ ) )
+        converged_ = false;
+    }
+    return converged_;
+  }
+
+  // record the decision and the achieved precision in the current
+  // directory: a TNamed "stopdecision" and a histogram "stopprecision"
+  // with one labelled bin per target and radius
+  void write( unsigned currentEvent, unsigned maxEvent ) {
+    if ( !active() )
+      return;
+    TH1D* achieved = new TH1D( "stopprecision", "Achieved Relative Precision of the Mean", targets_.size(), -0.5, targets_.size() - 0.5 );
+    for ( unsigned i = 0; i < targets_.size(); ++i ) {
+      update( targets_[i] );
+      std::ostringstream label;
+      label<<targets_[i].hist->GetName()<<"_"<<targets_[i].hist->GetXaxis()->GetBinLabel( targets_[i].bin );
+      achieved->GetXaxis()->SetBinLabel( i+1, label.str().c_str() );
+      achieved->SetBinContent( i+1, targets_[i].achieved );
+    }
+    achieved->Write();
+
+    std::ostringstream decision;
+    if ( converged_ )
+      decision<<"target precision "<<precision_<<" reached after "<<currentEvent<<" events";
+    else
+      decision<<"event cap of "<<maxEvent<<" reached before target precision "<<precision_<<" ( worst "<<worst()<<" )";
+    TNamed( "stopdecision", decision.str().c_str() ).Write();
+    std::cout<<"sequential stopping: "<<decision.str()<<std::endl;
+  }
+
+  bool converged() const { return converged_; }
+
+  double worst() const {
+    double w = 0;
+    for ( unsigned i = 0; i < targets_.size(); ++i )
+      w = std::max( w, targets_[i].achieved );
+    return w;
+  }
+
+private:
+
+  struct Target {
+    TH2* hist;
+    int bin;
+    double achieved;
+  };
+
+  bool addTarget( const std::string& name ) {
+    TH2* hist = dynamic_cast<TH2*>( gDirectory->Get( name.c_str() ) );
+    if ( !hist )
+      return false;
+    for ( int bin = 1; bin <= hist->GetXaxis()->GetNbins(); ++bin ) {
+      Target t = { hist, bin, std::numeric_limits<double>::infinity() };
+      targets_.push_back( t );
+    }
+    return true;
+  }
+
+  // weighted mean and its error for one radius bin
+  static void update( Target& t ) {
+    double sumw = 0, sumw2 = 0, sumwy = 0, sumwy2 = 0;
+    for ( int j = 1; j <= t.hist->GetYaxis()->GetNbins(); ++j ) {
+      double w = t.hist->GetBinContent( t.hist->GetBin( t.bin, j ) );
+      double e = t.hist->GetBinError( t.hist->GetBin( t.bin, j ) );
+      double y = t.hist->GetYaxis()->GetBinCenter( j );
+      sumw += w;
+      sumw2 += e * e;
+      sumwy += w * y;
+      sumwy2 += w * y * y;
+    }
+    t.achieved = std::numeric_limits<double>::infinity();
+    if ( sumw <= 0 || sumw2 <= 0 )
+      return;
+    double mean = sumwy / sumw;
+    double variance = sumwy2 / sumw - mean * mean;
+    double nEffective = sumw * sumw / sumw2;
+    if ( nEffective < 2 || mean == 0 )
+      return;
+    t.achieved = std::sqrt( std::max( variance, 0.0 ) / nEffective ) / std::fabs( mean );
+  }
+
+  std::vector<Target> targets_;
+  double precision_;
+  unsigned checkInterval_;
+  bool converged_;
+  unsigned lastCheck_;
+};
+
+#endif
@@ -0,0 +1,123 @@
+// SISCone clustering for the full radius sweep
+// Nick Elsey
+
+// SISCone dominates the per-event cost of the analysis
+// (compare the range of sisclustertime with the other
+// algorithms), so it gets its own execution path:
+// - the plugins are created once and owned here
+// - the radii are independent, so they are clustered
+//   concurrently by n_threads workers, each taking the
+//   next radius as it becomes free
+// - the stable cone search can be limited with a pass
+//   cap, a protojet pt cut and a split-merge stopping
+//   scale, to trade accuracy for throughput
+//
+// the ghosts come from the shared EventInput, see eventInput.hh
+//
+// note: with n_threads > 1 FastJet should be built with
+// --enable-limited-thread-safety, its warning and banner
+// bookkeeping is shared between threads
+
+#ifndef SISCONERUNNER_HH
+#define SISCONERUNNER_HH
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequenceActiveAreaExplicitGhosts.hh"
+#include "fastjet/SISConePlugin.hh"
+
+#include "eventInput.hh"
+
+struct SISConeSettings {
+  double overlap_threshold;           // split-merge overlap fraction f
+  int n_pass_max;                     // stable cone passes, 0 = until all particles are in a cone
+  double protojet_ptmin;              // protojets below this pt do not enter the split-merge
+  double split_merge_stopping_scale;  // split-merge stops below this scale, 0 = no cap
+  unsigned n_threads;                 // workers for the radius sweep
+
+  SISConeSettings() : overlap_threshold( 0.75 ), n_pass_max( 0 ), protojet_ptmin( 0.0 ),
+  split_merge_stopping_scale( 0.0 ), n_threads( 1 ) { }
+};
+
+class SISConeRunner {
+public:
+
+  SISConeRunner( const std::vector<double>& radii, const SISConeSettings& settings ) :
+  settings_( settings ), sequences_( radii.size() ),
+  times_( radii.size(), 0.0 ), nCones_( radii.size(), 0 ), eventTime_( 0.0 ) {
+    if ( settings_.n_threads == 0 )
+      settings_.n_threads = 1;
+    for ( unsigned i = 0; i < radii.size(); ++i ) {
+      plugins_.push_back( std::unique_ptr<fastjet::SISConePlugin>(
+        new fastjet::SISConePlugin( radii[i], settings_.overlap_threshold, settings_.n_pass_max,
+                                    settings_.protojet_ptmin, false, fastjet::SISConePlugin::SM_pttilde,
+                                    settings_.split_merge_stopping_scale ) ) );
+      defs_.push_back( fastjet::JetDefinition( plugins_.back().get() ) );
+    }
+  }
+
+  // cluster the event for every radius
+  // the sequences from the previous event are released here
+  void run( const EventInput& input ) {
+    typedef std::chrono::high_resolution_clock clock;
+    std::chrono::time_point<clock> start = clock::now();
+
+    std::atomic<unsigned> next( 0 );
+    auto work = [&]() {
+      for ( unsigned i = next++; i < defs_.size(); i = next++ ) {
+        std::chrono::time_point<clock> t0 = clock::now();
+        sequences_[i].reset( input.cluster( defs_[i] ) );
+        times_[i] = std::chrono::duration<double, std::milli>( clock::now() - t0 ).count();
+        nCones_[i] = countStableCones( *sequences_[i] );
+      }
+    };
+
+    unsigned nWorkers = std::min<unsigned>( settings_.n_threads, defs_.size() );
+    std::vector<std::thread> workers;
+    for ( unsigned i = 1; i < nWorkers; ++i )
+      workers.push_back( std::thread( work ) );
+    work();
+    for ( unsigned i = 0; i < workers.size(); ++i )
+      workers[i].join();
+
+    eventTime_ = std::chrono::duration<double, std::milli>( clock::now() - start ).count();
+  }
+
+  unsigned size() const { return defs_.size(); }
+  const fastjet::JetDefinition& definition( unsigned i ) const { return defs_[i]; }
+  const fastjet::ClusterSequenceAreaBase& sequence( unsigned i ) const { return *sequences_[i]; }
+
+  // clustering time in ms for radius i
+  double time( unsigned i ) const { return times_[i]; }
+  // number of inputs, ghosts included, clustered for radius i
+  unsigned nInputs( unsigned i ) const { return sequences_[i]->n_particles(); }
+  // number of stable cones found for radius i
+  unsigned nStableCones( unsigned i ) const { return nCones_[i]; }
+  // wall time in ms for the whole sweep in the last event
+  double eventTime() const { return eventTime_; }
+  const SISConeSettings& settings() const { return settings_; }
+
+private:
+
+  static unsigned countStableCones( const fastjet::ClusterSequence& cs ) {
+    const fastjet::SISConeExtras* extras = dynamic_cast<const fastjet::SISConeExtras*>( cs.extras() );
+    if ( !extras )
+      return 0;
+    return extras->protocones().size();
+  }
+
+  SISConeSettings settings_;
+  std::vector<std::unique_ptr<fastjet::SISConePlugin> > plugins_;
+  std::vector<fastjet::JetDefinition> defs_;
+  std::vector<std::unique_ptr<fastjet::ClusterSequenceActiveAreaExplicitGhosts> > sequences_;
+  std::vector<double> times_;
+  std::vector<unsigned> nCones_;
+  double eventTime_;
+};
+
+#endif
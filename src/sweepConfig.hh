@@ -0,0 +1,145 @@
+// radius sweep configuration
+// Nick Elsey
+
+// by default every jetfinder runs the radii 0.1 to 1.0 in steps
+// of 0.1. with sweep_file set, the list is read from a file
+// instead, one entry per line, # starts a comment:
+//   radius 0.4                  a single radius
+//   radii 0.02 1.0 0.02         first, last and step
+//   recombination WTA_pt_scheme recombination scheme of anti-kt,
+//                               kt and CA ( default E_scheme )
+// radii that agree to 1e-6 are clustered only once, and the sweep
+// runs in order of expected cost. the cost of every jetfinder
+// grows with the number of neighbours within R, so that is
+// increasing radius, which is also the order JetEEC and
+// JetMatchStudy rely on for reusing the previous radius
+
+#ifndef SWEEPCONFIG_HH
+#define SWEEPCONFIG_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+#include "fastjet/JetDefinition.hh"
+
+class SweepConfig {
+public:
+
+  SweepConfig() : scheme_( fastjet::E_scheme ), schemeName_( "E_scheme" ) {
+    for ( int i = 1; i <= 10; ++i )
+      radii_.push_back( 0.1 * i );
+  }
+
+  // replace the default sweep by the one in file
+  bool read( const std::string& file ) {
+    std::ifstream in( file.c_str() );
+    if ( !in ) {
+      std::cerr<<"Error: could not open sweep file "<<file<<std::endl;
+      return false;
+    }
+    std::vector<double> radii;
+    std::string line;
+    int lineNumber = 0;
+    while ( std::getline( in, line ) ) {
+      lineNumber++;
+      line = line.substr( 0, line.find( '#' ) );
+      std::istringstream fields( line );
+      std::string key;
+      if ( !( fields >> key ) )
+        continue;
+      bool good = true;
+      if ( key == "radius" ) {
+        double r;
+        good = ( fields >> r ) && addRadius( r, radii );
+      }
+      else if ( key == "radii" ) {
+        double first, last, step;
+        good = ( fields >> first >> last >> step ) && step > 0;
+        // the tolerance keeps the last radius despite rounding
+        for ( int i = 0; good && first + i * step <= last + 1e-9; ++i )
+          good = addRadius( first + i * step, radii );
+      }
+      else if ( key == "recombination" ) {
+        std::string name;
+        good = ( fields >> name ) && setScheme( name );
+      }
+      else
+        good = false;
+      if ( !good ) {
+        std::cerr<<"Error: could not parse line "<<lineNumber<<" of sweep file "<<file<<": "<<line<<std::endl;
+        return false;
+      }
+    }
+    if ( radii.empty() ) {
+      std::cerr<<"Error: sweep file "<<file<<" has no radii"<<std::endl;
+      return false;
+    }
+
+    // in order of cost, then drop duplicates
+    std::sort( radii.begin(), radii.end() );
+    radii_.clear();
+    for ( unsigned i = 0; i < radii.size(); ++i )
+      if ( radii_.empty() || radii[i] - radii_.back() > tolerance )
+        radii_.push_back( radii[i] );
+    if ( radii_.size() < radii.size() )
+      std::cout<<"sweep: removed "<<radii.size() - radii_.size()<<" duplicate radii"<<std::endl;
+    return true;
+  }
+
+  const std::vector<double>& radii() const { return radii_; }
+  unsigned size() const { return radii_.size(); }
+  fastjet::RecombinationScheme scheme() const { return scheme_; }
+  const std::string& schemeName() const { return schemeName_; }
+
+  // index of radius in the sweep, -1 if it is not part of it
+  int index( double radius ) const {
+    for ( unsigned i = 0; i < radii_.size(); ++i )
+      if ( std::fabs( radii_[i] - radius ) < tolerance )
+        return i;
+    return -1;
+  }
+
+private:
+
+  static constexpr double tolerance = 1e-6;
+  // beyond this the ghosts reach far past any detector
+  static constexpr double maxRadius = 2.0;
+
+  bool addRadius( double r, std::vector<double>& radii ) {
+    if ( r <= 0 || r > maxRadius ) {
+      std::cerr<<"Error: sweep radius "<<r<<" is outside ( 0, "<<maxRadius<<" ]"<<std::endl;
+      return false;
+    }
+    // round to the tolerance, so the radius labels stay short
+    radii.push_back( std::floor( r / tolerance + 0.5 ) * tolerance );
+    return true;
+  }
+
+  bool setScheme( const std::string& name ) {
+    const char* names[] = { "E_scheme", "pt_scheme", "pt2_scheme", "Et_scheme", "Et2_scheme",
+                            "BIpt_scheme", "BIpt2_scheme", "WTA_pt_scheme" };
+    const fastjet::RecombinationScheme schemes[] = { fastjet::E_scheme, fastjet::pt_scheme, fastjet::pt2_scheme,
+                                                     fastjet::Et_scheme, fastjet::Et2_scheme, fastjet::BIpt_scheme,
+                                                     fastjet::BIpt2_scheme, fastjet::WTA_pt_scheme };
+    for ( unsigned i = 0; i < sizeof( names ) / sizeof( names[0] ); ++i ) {
+      if ( name == names[i] ) {
+        scheme_ = schemes[i];
+        schemeName_ = name;
+        return true;
+      }
+    }
+    std::cerr<<"Error: unknown recombination scheme "<<name<<std::endl;
+    return false;
+  }
+
+  std::vector<double> radii_;
+  fastjet::RecombinationScheme scheme_;
+  std::string schemeName_;
+};
+
+#endif
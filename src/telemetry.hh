@@ -0,0 +1,180 @@
+// live progress and resource telemetry for running jobs
+// Nick Elsey
+
+// a background thread wakes up every `interval` seconds and
+// appends one JSON record per line to a side file:
+//   t         seconds since start
+//   events    events processed so far
+//   rate      events/sec over the last interval
+//   rate_ewma exponentially weighted events/sec
+//   share     fraction of wall time spent clustering, per algorithm
+//   rss_mb    resident set size, peak_rss_mb its high-water mark
+//   cpu_s     user + system CPU time
+//   eta_s     remaining time at the EWMA rate
+// a short human readable progress line goes to stdout, at most
+// once every `progressInterval` seconds
+//
+// the event loop only touches atomics ( eventDone, addClusterTime )
+// so it is never blocked by the telemetry thread
+
+#ifndef TELEMETRY_HH
+#define TELEMETRY_HH
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <sys/resource.h>
+
+class Telemetry {
+public:
+
+  typedef std::chrono::steady_clock clock;
+
+  Telemetry( const std::vector<std::string>& algorithms, unsigned long maxEvents ) :
+  algorithms_( algorithms ), clusterNs_( algorithms.size() ), maxEvents_( maxEvents ),
+  events_( 0 ), running_( false ), interval_( 10.0 ), progressInterval_( 60.0 ) {
+    for ( unsigned i = 0; i < clusterNs_.size(); ++i )
+      clusterNs_[i] = 0;
+  }
+
+  ~Telemetry() { stop(); }
+
+  // file may be empty, in which case only stdout progress is given
+  void start( const std::string& file, double interval, double progressInterval ) {
+    if ( running_ )
+      return;
+    if ( !file.empty() ) {
+      out_.open( file.c_str() );
+      if ( !out_ )
+        std::cerr<<"Warning: could not open telemetry file "<<file<<std::endl;
+    }
+    interval_ = interval > 0 ? interval : 10.0;
+    progressInterval_ = progressInterval;
+    start_ = clock::now();
+    running_ = true;
+    thread_ = std::thread( &Telemetry::loop, this );
+  }
+
+  // write a final record and join the thread
+  void stop() {
+    if ( !running_ )
+      return;
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      running_ = false;
+    }
+    wake_.notify_all();
+    thread_.join();
+    out_.close();
+  }
+
+  void eventDone() { events_++; }
+  unsigned long events() const { return events_; }
+
+  // cumulative clustering time for algorithm idx
+  template < typename Duration > void addClusterTime( unsigned idx, const Duration& d ) {
+    clusterNs_[idx] += std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count();
+  }
+
+  // memory in MB from /proc/self/status ( Linux only, 0 elsewhere )
+  static void memoryUsage( double& rss, double& peak ) {
+    rss = peak = 0;
+    std::ifstream status( "/proc/self/status" );
+    std::string key;
+    while ( status >> key ) {
+      if ( key == "VmRSS:" ) { status >> rss; rss /= 1024.0; }
+      else if ( key == "VmHWM:" ) { status >> peak; peak /= 1024.0; }
+      status.ignore( 256, '\n' );
+    }
+    if ( peak == 0 ) {
+      struct rusage usage;
+      getrusage( RUSAGE_SELF, &usage );
+      peak = usage.ru_maxrss / 1024.0;
+    }
+  }
+
+  static double cpuTime() {
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6 * ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec );
+  }
+
+private:
+
+  void loop() {
+    clock::time_point last = start_;
+    clock::time_point lastProgress = start_;
+    unsigned long lastEvents = 0;
+    std::vector<long long> lastNs( clusterNs_.size(), 0 );
+    double ewma = 0;
+    bool first = true;
+
+    std::unique_lock<std::mutex> lock( mutex_ );
+    while ( true ) {
+      wake_.wait_for( lock, std::chrono::duration<double>( interval_ ), [this]() { return !running_; } );
+      bool finished = !running_;
+
+      clock::time_point now = clock::now();
+      double dt = std::chrono::duration<double>( now - last ).count();
+      double elapsed = std::chrono::duration<double>( now - start_ ).count();
+      unsigned long events = events_;
+      double rate = dt > 0 ? ( events - lastEvents ) / dt : 0;
+      ewma = first ? rate : 0.3 * rate + 0.7 * ewma;
+      first = false;
+      double eta = ewma > 0 && maxEvents_ > events ? ( maxEvents_ - events ) / ewma : 0;
+
+      double rss, peak;
+      memoryUsage( rss, peak );
+
+      if ( out_ ) {
+        out_<<std::fixed<<std::setprecision( 3 );
+        out_<<"{\"t\":"<<elapsed<<",\"events\":"<<events<<",\"rate\":"<<rate<<",\"rate_ewma\":"<<ewma<<",\"share\":{";
+        for ( unsigned i = 0; i < clusterNs_.size(); ++i ) {
+          long long ns = clusterNs_[i];
+          out_<<( i ? "," : "" )<<"\""<<algorithms_[i]<<"\":"<<( dt > 0 ? 1e-9 * ( ns - lastNs[i] ) / dt : 0 );
+          lastNs[i] = ns;
+        }
+        out_<<"},\"rss_mb\":"<<rss<<",\"peak_rss_mb\":"<<peak<<",\"cpu_s\":"<<cpuTime()<<",\"eta_s\":"<<eta
+            <<( finished ? ",\"final\":true" : "" )<<"}"<<std::endl;
+      }
+
+      if ( progressInterval_ >= 0 && ( finished || std::chrono::duration<double>( now - lastProgress ).count() >= progressInterval_ ) ) {
+        std::ostringstream line;
+        line<<"Event: "<<events<<" / "<<maxEvents_<<std::fixed<<std::setprecision( 2 )
+            <<"  "<<ewma<<" ev/s  ETA "<<eta<<" s  RSS "<<rss<<" MB (peak "<<peak<<" MB)";
+        std::cout<<line.str()<<std::endl;
+        lastProgress = now;
+      }
+
+      last = now;
+      lastEvents = events;
+      if ( finished )
+        break;
+    }
+  }
+
+  std::vector<std::string> algorithms_;
+  std::vector<std::atomic<long long> > clusterNs_;
+  unsigned long maxEvents_;
+  std::atomic<unsigned long> events_;
+
+  bool running_;
+  double interval_;
+  double progressInterval_;
+  clock::time_point start_;
+  std::ofstream out_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+};
+
+#endif
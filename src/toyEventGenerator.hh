@@ -0,0 +1,128 @@
+// synthetic events for clustering scaling studies
+// Nick Elsey
+
+// an alternative to pythia.next() + readPythiaEvent that
+// produces events of a chosen multiplicity at almost no cost:
+// - a thermal background of nBackground particles, pt drawn
+//   from pt * exp( -pt / T ), flat in rapidity within |y| < yMax
+//   and flat in phi
+// - an embedded hard dijet: two back-to-back axes with pt
+//   jetPt, each split into jetParticles collinear fragments
+//   with a gaussian angular spread jetWidth around the axis
+// the two dijet axes ( the sum of their fragments ) fill the
+// parton vector, so the jet - parton comparisons still work.
+// two thirds of the particles are charged, and as for pythia
+// events the user_index() is the charge
+
+#ifndef TOYEVENTGENERATOR_HH
+#define TOYEVENTGENERATOR_HH
+
+#include <vector>
+#include <random>
+#include <cmath>
+
+#include "fastjet/PseudoJet.hh"
+
+struct ToySettings {
+  double multiplicity;   // mean number of background particles
+  bool poisson;          // poisson fluctuations of the multiplicity, otherwise fixed
+  double temperature;    // slope of the background pt spectrum ( GeV )
+  double yMax;           // rapidity range of all particles
+  double jetPt;          // pt of each hard jet
+  unsigned jetParticles; // fragments per hard jet
+  double jetWidth;       // gaussian angular spread of the fragments
+  unsigned seed;
+
+  ToySettings() : multiplicity( 1000 ), poisson( true ), temperature( 0.5 ), yMax( 4.0 ),
+  jetPt( 200 ), jetParticles( 20 ), jetWidth( 0.1 ), seed( 0 ) { }
+};
+
+class ToyEventGenerator {
+public:
+
+  explicit ToyEventGenerator( const ToySettings& settings ) :
+  settings_( settings ), rng_( settings.seed ? settings.seed : std::random_device()() ),
+  uniform_( 0.0, 1.0 ), gaus_( 0.0, 1.0 ), background_( settings.multiplicity > 0 ? settings.multiplicity : 1 ),
+  thermal_( 2.0, settings.temperature ) { }
+
+  // restart the random sequence, e.g. for a new block of events
+  void reseed( unsigned seed ) { rng_.seed( seed ); }
+
+  // fills the same containers the sweep makes from pythia events
+  void next( std::vector<fastjet::PseudoJet>& all, std::vector<fastjet::PseudoJet>& charged, std::vector<fastjet::PseudoJet>& part ) {
+    all.clear();
+    charged.clear();
+    part.clear();
+
+    unsigned nBackground = settings_.poisson ? background_( rng_ ) : (unsigned) settings_.multiplicity;
+    all.reserve( nBackground + 2 * settings_.jetParticles );
+    charged.reserve( all.capacity() );
+
+    // hard dijet, back to back in phi, with the axes kept
+    // far enough inside the acceptance to contain the jet
+    double jetYMax = std::max( settings_.yMax - 1.0, 0.0 );
+    double phi = 2.0 * M_PI * uniform_( rng_ );
+    for ( int j = 0; j < 2; ++j ) {
+      double y = jetYMax * ( 2.0 * uniform_( rng_ ) - 1.0 );
+      double axisPhi = phi + j * M_PI;
+
+      // split the jet pt over the fragments with a random partition
+      double z[256];
+      unsigned n = std::min( std::max( settings_.jetParticles, 1u ), 256u );
+      double zSum = 0;
+      for ( unsigned i = 0; i < n; ++i ) {
+        z[i] = -std::log( 1.0 - uniform_( rng_ ) );
+        zSum += z[i];
+      }
+
+      fastjet::PseudoJet axis;
+      for ( unsigned i = 0; i < n; ++i ) {
+        double fragY = y + settings_.jetWidth * gaus_( rng_ );
+        double fragPhi = axisPhi + settings_.jetWidth * gaus_( rng_ );
+        if ( std::fabs( fragY ) > settings_.yMax )
+          continue;
+        fastjet::PseudoJet fragment = makeParticle( settings_.jetPt * z[i] / zSum, fragY, fragPhi );
+        axis += fragment;
+        add( fragment, all, charged );
+      }
+      axis.set_user_index( 0 );
+      part.push_back( axis );
+    }
+
+    // thermal background
+    for ( unsigned i = 0; i < nBackground; ++i ) {
+      double y = settings_.yMax * ( 2.0 * uniform_( rng_ ) - 1.0 );
+      double phi = 2.0 * M_PI * uniform_( rng_ );
+      add( makeParticle( thermal_( rng_ ), y, phi ), all, charged );
+    }
+  }
+
+  const ToySettings& settings() const { return settings_; }
+
+private:
+
+  // charged pions and neutral particles in a 2:1 ratio
+  fastjet::PseudoJet makeParticle( double pt, double y, double phi ) {
+    static const double mPion = 0.13957;
+    double mt = std::sqrt( pt * pt + mPion * mPion );
+    fastjet::PseudoJet p( pt * std::cos( phi ), pt * std::sin( phi ), mt * std::sinh( y ), mt * std::cosh( y ) );
+    double r = 3.0 * uniform_( rng_ );
+    p.set_user_index( r < 1.0 ? 1 : ( r < 2.0 ? -1 : 0 ) );
+    return p;
+  }
+
+  static void add( const fastjet::PseudoJet& p, std::vector<fastjet::PseudoJet>& all, std::vector<fastjet::PseudoJet>& charged ) {
+    all.push_back( p );
+    if ( p.user_index() )
+      charged.push_back( p );
+  }
+
+  ToySettings settings_;
+  std::mt19937_64 rng_;
+  std::uniform_real_distribution<double> uniform_;
+  std::normal_distribution<double> gaus_;
+  std::poisson_distribution<unsigned> background_;
+  std::gamma_distribution<double> thermal_;
+};
+
+#endif
@@ -0,0 +1,242 @@
+// pull-based event blocks shared by local workers
+// Nick Elsey
+
+// grid_jetfinding.csh gives every job the same number of events,
+// and with the event to event spread of the SISCone cost the last
+// jobs finish long after the first. with work_dir set, the
+// 10^exponent events are instead split into blocks of
+// work_blocksize events, each with its own seed, and every worker
+// started on the same work_dir pulls the next free block until
+// none are left. the state lives in work_dir/leases, one line per
+// block:
+//   <block> free|leased|done <owner> <time of the last heartbeat>
+// read and rewritten under flock, so it works for any number of
+// workers on one machine or a shared file system with working
+// locks. a leased block whose owner has not renewed it within
+// work_timeout seconds ( the worker died ) is handed out again.
+//
+// after each block a worker writes all of its histograms to
+// work_dir/worker_<host>_<pid>.root ( through a temporary file and
+// a rename ) and only then marks the block done, so the files of
+// all workers, dead or alive, together hold every done block
+// exactly once:
+//   hadd result.root work_dir/worker_*.root
+// a worker that stalls past work_timeout loses its block to the
+// next one. once it notices, in heartbeat() or complete(), it
+// stops without writing again: its file already holds every block
+// it finished, and its histograms now hold part of a block that
+// someone else owns
+// the histograms are stored raw, so only unweighted generation
+// ( gen_mode=unbiased or toy events ) is supported
+
+#ifndef WORKQUEUE_HH
+#define WORKQUEUE_HH
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <ctime>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "TH1.h"
+#include "TList.h"
+#include "TDirectory.h"
+#include "TFile.h"
+
+class WorkQueue {
+public:
+
+  WorkQueue( const std::string& dir, unsigned long totalEvents, unsigned long blockSize, unsigned seed, double timeout ) :
+  dir_( dir ), totalEvents_( totalEvents ), blockSize_( blockSize ? blockSize : 1 ), seed_( seed ? seed : 1 ),
+  timeout_( timeout ), block_( -1 ), lastBeat_( 0 ), nDone_( 0 ), warned_( false ), lost_( false ) {
+    if ( dir_.empty() )
+      return;
+    char host[256] = "localhost";
+    gethostname( host, sizeof( host ) - 1 );
+    std::ostringstream owner;
+    owner<<host<<"_"<<getpid();
+    owner_ = owner.str();
+  }
+
+  bool enabled() const { return !dir_.empty(); }
+
+  // the current block was handed to another worker, stop
+  bool lost() const { return lost_; }
+
+  // lease the next block, false when there is none left
+  bool claim( unsigned long& events, unsigned& seed ) {
+    if ( !enabled() || lost_ )
+      return false;
+    std::vector<Lease> leases;
+    int fd = lock( leases );
+    if ( fd < 0 )
+      return false;
+    long now = std::time( 0 );
+    for ( unsigned i = 0; i < leases.size() && block_ < 0; ++i ) {
+      Lease& l = leases[i];
+      bool expired = l.state == "leased" && now - l.time > timeout_;
+      if ( l.state != "free" && !expired )
+        continue;
+      if ( expired )
+        std::cout<<"work: block "<<i<<" of "<<l.owner<<" expired, taking it over"<<std::endl;
+      l.state = "leased";
+      l.owner = owner_;
+      l.time = now;
+      block_ = i;
+    }
+    unlock( fd, leases, block_ >= 0 );
+    if ( block_ < 0 )
+      return false;
+    lastBeat_ = now;
+    unsigned long first = block_ * blockSize_;
+    events = first < totalEvents_ ? std::min( blockSize_, totalEvents_ - first ) : blockSize_;
+    seed = seed_ + block_;
+    std::cout<<"work: "<<owner_<<" took block "<<block_<<", "<<events<<" events, seed "<<seed<<std::endl;
+    return true;
+  }
+
+  // renew the lease on the current block, a quarter timeout apart
+  void heartbeat() {
+    if ( block_ < 0 )
+      return;
+    long now = std::time( 0 );
+    if ( now - lastBeat_ < timeout_ / 4 )
+      return;
+    lastBeat_ = now;
+    std::vector<Lease> leases;
+    int fd = lock( leases );
+    if ( fd < 0 )
+      return;
+    bool owned = leases[block_].owner == owner_;
+    if ( owned )
+      leases[block_].time = now;
+    unlock( fd, leases, owned );
+    if ( !owned )
+      lose( leases[block_].owner );
+  }
+
+  // the current block is finished: store the histograms held by
+  // hists, then mark it done
+  void complete( TDirectory* hists ) {
+    if ( block_ < 0 )
+      return;
+    std::string file = dir_ + "/worker_" + owner_ + ".root";
+    std::string temporary = file + ".tmp";
+    TDirectory* saved = gDirectory;
+    TFile out( temporary.c_str(), "RECREATE" );
+    TList* list = hists->GetList();
+    for ( int i = 0; i < list->GetSize(); ++i ) {
+      TH1* h = dynamic_cast<TH1*>( list->At( i ) );
+      if ( h )
+        out.WriteTObject( h );
+    }
+    out.Close();
+    saved->cd();
+
+    std::vector<Lease> leases;
+    int fd = lock( leases );
+    if ( fd < 0 )
+      return;
+    if ( leases[block_].owner != owner_ ) {
+      unlock( fd, leases, false );
+      std::remove( temporary.c_str() );
+      lose( leases[block_].owner );
+      return;
+    }
+    if ( std::rename( temporary.c_str(), file.c_str() ) != 0 )
+      std::cerr<<"Error: could not write "<<file<<std::endl;
+    else {
+      leases[block_].state = "done";
+      leases[block_].owner = owner_;
+      leases[block_].time = std::time( 0 );
+      nDone_++;
+    }
+    unlock( fd, leases, true );
+    block_ = -1;
+  }
+
+  unsigned blocksDone() const { return nDone_; }
+
+private:
+
+  struct Lease {
+    std::string state;
+    std::string owner;
+    long time;
+  };
+
+  void lose( const std::string& owner ) {
+    std::cerr<<"Warning: block "<<block_<<" was handed to "<<owner<<", stopping, raise work_timeout"<<std::endl;
+    lost_ = true;
+    block_ = -1;
+  }
+
+  // lock the lease file and read it, creating the blocks on first use
+  int lock( std::vector<Lease>& leases ) {
+    std::string file = dir_ + "/leases";
+    int fd = open( file.c_str(), O_RDWR | O_CREAT, 0644 );
+    if ( fd < 0 || flock( fd, LOCK_EX ) != 0 ) {
+      std::cerr<<"Error: could not lock "<<file<<std::endl;
+      if ( fd >= 0 )
+        close( fd );
+      return -1;
+    }
+    std::string content;
+    char buffer[4096];
+    ssize_t n;
+    while ( ( n = read( fd, buffer, sizeof( buffer ) ) ) > 0 )
+      content.append( buffer, n );
+
+    leases.clear();
+    std::istringstream lines( content );
+    unsigned long index;
+    Lease l;
+    while ( lines >> index >> l.state >> l.owner >> l.time )
+      leases.push_back( l );
+    unsigned long nBlocks = ( totalEvents_ + blockSize_ - 1 ) / blockSize_;
+    if ( leases.empty() ) {
+      l.state = "free";
+      l.owner = "-";
+      l.time = 0;
+      leases.assign( nBlocks, l );
+    }
+    else if ( leases.size() != nBlocks && !warned_ ) {
+      warned_ = true;
+      std::cerr<<"Warning: "<<file<<" has "<<leases.size()<<" blocks, not "<<nBlocks<<", keeping the file's"<<std::endl;
+    }
+    return fd;
+  }
+
+  void unlock( int fd, const std::vector<Lease>& leases, bool changed ) {
+    if ( changed ) {
+      std::ostringstream out;
+      for ( unsigned i = 0; i < leases.size(); ++i )
+        out<<i<<" "<<leases[i].state<<" "<<leases[i].owner<<" "<<leases[i].time<<"\n";
+      std::string content = out.str();
+      if ( ftruncate( fd, 0 ) != 0 || pwrite( fd, content.data(), content.size(), 0 ) != (ssize_t) content.size() )
+        std::cerr<<"Error: could not update "<<dir_<<"/leases"<<std::endl;
+    }
+    flock( fd, LOCK_UN );
+    close( fd );
+  }
+
+  std::string dir_;
+  std::string owner_;
+  unsigned long totalEvents_;
+  unsigned long blockSize_;
+  unsigned seed_;
+  double timeout_;
+  long block_;
+  long lastBeat_;
+  unsigned nDone_;
+  bool warned_;
+  bool lost_;
+};
+
+#endif
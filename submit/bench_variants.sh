@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+
+# times each build variant of jetFindAnalysis on the same
+# fixed-seed workload and reports the speedup over the
+# default build. variants that have not been built are skipped
+#
+# usage: submit/bench_variants.sh xmldir [exponent] [key=value ...]
+
+xmldir=$1
+exponent=${2:-1}
+shift $(( $# < 2 ? $# : 2 ))
+extra="$*"
+
+mkdir -p tmp
+
+base=""
+printf "%-10s %12s %10s\n" "variant" "seconds" "speedup"
+for variant in default release lto pgo; do
+  if [ "$variant" == "default" ]; then
+    exe=./bin/jetFindAnalysis
+  else
+    exe=./bin/$variant/jetFindAnalysis
+  fi
+  [ -x $exe ] || continue
+
+  start=$(date +%s.%N)
+  $exe $xmldir $exponent tmp/bench_$variant.root seed=12345 telemetry_file=none progress_interval=-1 $extra > tmp/bench_$variant.log 2>&1 || { echo "$variant failed, see tmp/bench_$variant.log"; continue; }
+  end=$(date +%s.%N)
+  seconds=$(echo "$end - $start" | bc -l)
+
+  [ -z "$base" ] && base=$seconds
+  printf "%-10s %12.2f %10.2f\n" $variant $seconds $(echo "$base / $seconds" | bc -l)
+done